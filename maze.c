@@ -11,24 +11,116 @@
  * Rev 1.4 -- push mid wall openings left and down when done
  * Rev 1.5 -- add recursive, variable depth look ahead
  * Rev 1.6 -- eliminate 1x1 orphans during construction
+ * Rev 1.7 -- survey all bottom openings from each top opening in one pass
+ * Rev 1.8 -- add multi-threaded opening search
+ * Rev 1.9 -- add headless batch output of mazes to a file
+ * Rev 2.0 -- allocate the maze at run time instead of a fixed maximum size
+ * Rev 2.1 -- add compact (bit-plane) maze representation for large mazes
+ * Rev 2.2 -- keep an index of where new paths can start instead of rescanning the maze
+ * Rev 2.3 -- iterative look ahead that remembers pockets too small to reach the search depth
+ * Rev 2.4 -- only redraw what changed on the screen, a frame at a time
+ * Rev 2.5 -- draw from a separate thread at a fixed frame rate instead of slowing down carving
+ * Rev 2.6 -- add binary maze files, and reading them back in to solve or draw
+ * Rev 2.7 -- add breadth first, dead end filling and A* solvers
+ * Rev 2.8 -- undo solving from a journal of the paths it changed instead of scanning the whole maze
+ * Rev 2.9 -- keep a mask of open walls & neighbouring paths for each cell while carving
+ * Rev 3.0 -- write output files a row at a time, 16 locations at once
+ * Rev 3.1 -- add a benchmark timing each phase of making mazes over a range of sizes & depths
+ * Rev 3.2 -- add --stats=json, writing look ahead, orphan, path start & phase stats per maze & per run
+ * Rev 3.3 -- try --path seeds in several processes at once, keeping the lowest seed that works
+ * Rev 3.4 -- keep everything about a maze in a context of its own, with its own random numbers
+ * Rev 3.5 -- build as a library too (-DLIBMAZE), with the interface in maze.h
+ * Rev 3.6 -- carve big mazes in tiles, in parallel, joined into one perfect maze
+ * Rev 3.7 -- stream mazes of any height a row at a time (Eller's algorithm), in O(width) memory
+ * Rev 3.8 -- push mid wall openings from a worklist after one sweep, instead of sweeping until there are none
+ * Rev 3.9 -- analyze each maze once as a tree for --stats, and skip the openings search for mazes --path rejects
+ * Rev 4.0 -- -F pbm & -F png, with -C to size the cells: mazes as images, written a row at a time
+ * Rev 4.1 -- --serve: hand out binary mazes over a unix socket from pools kept ready by worker threads
+ * Rev 4.2 -- maze_watch() in the library, telling a caller of each change as the maze is made (maze.cpp draws with it)
+ * Rev 4.3 -- look ahead one or two cells without the general search, the depths most mazes are made with
+ * Rev 4.4 -- -DBLOCKED_MAZE keeps the maze in 8x8 blocks of locations instead of row by row
+ * Rev 4.5 -- walls hash & wall pushes in --stats, and maze_walls_hash(), for regress.sh to check mazes against
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <getopt.h>
-#include <termios.h>
+#include <pthread.h>
 #include <time.h>
 #include <math.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#ifdef  _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+#ifndef LIBMAZE                     // just the utility's: its terminal, --path workers and --serve
+#include <termios.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "maze.h"
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-#define VERSION             "1.6"
+#define VERSION             "4.5"
 #define UTS_SIGN_ON         "\n""Maze Generation Console Utility " VERSION \
                             "\n""Copyright (c) 2016""\n\n"
 
-#define MAX_WIDTH           300
-#define MAX_HEIGHT          100
-#define MAX_X               ((MAX_HEIGHT + 1)*2 + 1)
-#define MAX_Y               ((MAX_WIDTH +  1)*2 + 1)
+#define MAX_SIZE            32767                           // largest height or width (keeps cell counts within an int)
+#define DEFAULT_HEIGHT      100                             // size of the mazes made without -h or -w, when not drawing them
+#define DEFAULT_WIDTH       300
+#define MAX_STREAM_HEIGHT   ((INT32_MAX - 2*GUARD - 8)/2)   // tallest --stream maze (keeps row numbers within an int)
+#define MAX_THREADS         64
+#define MAX_JOBS            64                              // most processes trying seeds at once for --path
+#define MAX_CELL_PX         64                              // biggest image cells
+#define MAX_CHECKS          500000                          // default look ahead checks before giving up and assuming the path fits
+
+#define GUARD               2                               // rows & columns of path around the maze so x±2, y±2 probes never leave the grid
+#define ROW_ALIGN           64                              // rows start on cache line boundaries
+#define HUGE_GRID           (2 << 20)                       // grids at least this big are mmap'ed (and backed by huge pages if possible)
+#define PAGE_BITS           12                              // solver state overlay pages (compact mazes only) hold 4096 states each
+#ifndef BLOCK_BITS
+#define BLOCK_BITS          3                               // blocks of a -DBLOCKED_MAZE grid are 8x8 locations, a cache line each
+#endif
+#define RING_SIZE           (1 << 16)                       // maze changes waiting to be drawn (a power of 2)
+#define MAX_FPS             1000                            // most frames actually drawn per second
+
+#define MAZE_MAGIC          "MAZE"                          // binary maze files
+#define MAZE_VERSION        1
+#define BYTE_ORDER_MARK     0x01020304
+
+#define DFS_SOLVER          0                               // solver_tbl[] index of the original solver
+
+#define RAND_RNG            0                               // random numbers just like glibc's rand(), so seeds make the mazes they always have
+#define PCG_RNG             1                               // PCG32, faster
+
+#define ASCII_FORMAT        0                               // output formats
+#define BINARY_FORMAT       1
+#define CSV_FORMAT          2                               // benchmark results
+#define JSON_FORMAT         3
+#define PBM_FORMAT          4                               // images
+#define PNG_FORMAT          5
+
+#define INIT_PHASE          0                               // phases of making a maze, each timed separately
+#define CARVE_PHASE         1
+#define PUSH_PHASE          2
+#define ANALYZE_PHASE       3
+#define OPENINGS_PHASE      4
+#define SOLVE_PHASE         5
+#define NUM_PHASES          6
+
+#define BENCH_RUNS          5                               // mazes per benchmark size & depth, by default
+#define MAX_DEPTH           100                             // deepest look ahead
+#define TURN_BUCKETS        16                              // --stats passages by their turns, the last for any with more
 
 #define PATH                0
 #define WALL                1
@@ -75,52 +167,300 @@
 #define VERTICAL            '|'
 #endif
 
-char blank_line   [] = "                                                  ";
-char output_lookup[] = { BLANK     , VERTICAL    , HORIZONTAL, LEFT_BOTTOM ,
-                         VERTICAL  , VERTICAL    , LEFT_TOP  , RIGHT_TEE   ,
-                         HORIZONTAL, RIGHT_BOTTOM, HORIZONTAL, UP_TEE      ,
-                         RIGHT_TOP , LEFT_TEE    , DOWN_TEE  , INTERSECTION };
+#ifndef LIBMAZE
+static char blank_line   [] = "                                                  ";
+static char output_lookup[] = { BLANK     , VERTICAL    , HORIZONTAL, LEFT_BOTTOM ,
+                                VERTICAL  , VERTICAL    , LEFT_TOP  , RIGHT_TEE   ,
+                                HORIZONTAL, RIGHT_BOTTOM, HORIZONTAL, UP_TEE      ,
+                                RIGHT_TOP , LEFT_TEE    , DOWN_TEE  , INTERSECTION };
+static char simple_lookup[] = { ' '       , '|'         , '-'       , '+'         ,      // portable ascii version used for
+                                '|'       , '|'         , '+'       , '+'         ,      // mazes written to an output file
+                                '-'       , '+'         , '-'       , '+'         ,
+                                '+'       , '+'         , '+'       , '+'          };
+static char state_lookup [] = { ' '       , ' '         , '*'       , '.'         ,      // and what's not a wall, by value
+                                '#'       , ' '         , ' '       , ' '         ,
+                                ' '       , ' '         , ' '       , ' '         ,
+                                ' '       , ' '         , ' '       , ' '          };
+#endif
+
+#ifndef COMPACT_MAZE
+typedef char *grid_t;        // one byte per cell, location 0, 0 of the maze (or a private copy of it)
+#else
+typedef struct overlay_type {
+    uint64_t **page;         // pages of two bit SOLVED, TRIED or CHECK states (NULL until one is set)
+    long      *used;         // pages allocated so far, so clearing costs only what was touched
+    long       num_used;
+    long       num_pages;
+} *grid_t;                   // walls are shared bit-planes, solver states a private sparse overlay
+
+static const int state_tbl[4] = { PATH, SOLVED, TRIED, CHECK };
+#endif
+
+// A binary maze file is one or more mazes, each a header followed (at the next 64 byte boundary) by the walls
+// as three bit-planes, laid out just as a compact maze keeps them in memory: cells, right walls and down walls,
+// each plane_rows rows of plane_stride bits, covering the guard band too.  A set bit is a wall, posts aren't
+// stored as they're always walls.  Everything is in the byte order of the machine that wrote it.
+struct maze_header {
+    char     magic[4];              // MAZE_MAGIC
+    uint16_t version;               // MAZE_VERSION
+    uint16_t header_size;
+    uint32_t byte_order;            // BYTE_ORDER_MARK
+    int32_t  height;
+    int32_t  width;
+    int32_t  seed;
+    int32_t  depth;
+    int32_t  beg_y;                 // top & bottom openings
+    int32_t  end_y;
+    int32_t  max_path_length;
+    int32_t  num_paths;
+    int32_t  maze_len;
+    int32_t  num_wall_push;
+    int32_t  num_solves;
+    int32_t  max_checks;
+    int32_t  num_check_exceeded;
+    int64_t  plane_stride;          // bits, a multiple of 64
+    int64_t  plane_rows;
+    uint64_t size;                  // bytes from this header to the next, a multiple of 64
+};
 
-char maze[MAX_X][MAX_Y] = {};
 struct dir_tbl_type {
     int x;
     int y;
     int heading;
-} dir_tbl[4];
-
-int max_x    = 0;
-int max_y    = 0;
-int width    = 0;
-int height   = 0;
-int delay    = 0;
-int fps      = 0;
-int blank    = 0;
-int path_len = 0;
-int maze_len = 0;
-int turn_cnt = 0;
-int solves   = 0;
-int depth    = 0;
-int seed     = 0;
-int beg_x, end_x;
-int beg_y, end_y;
-
-int path_depth       = 0;
-int num_checks       = 0;
-int max_checks       = 0;
-int num_paths        = 0;
-int num_solves       = 0;
-int num_wall_push    = 0;
-int max_path_length  = 0;
-int num_maze_created = 0;
-
-#define ms_sleep(n)         ({ int _n = (n); struct timespec tr = {_n / 1000, (_n % 1000) * 1000 * 1000}; nanosleep(&tr, NULL); })   // millisecond sleep
+};
+
+static const struct dir_tbl_type solve_tbl[4] = {      // same order find_directions() looks in
+    { -2,  0, LEFT  },
+    {  2,  0, RIGHT },
+    {  0, -2, UP    },
+    {  0,  2, DOWN  }
+};
+
+struct survey_type {            // best bottom opening found for one top opening
+    int finish;
+    int path_len;
+    int turn_cnt;
+    int solves;
+};
+
+struct check_type {                 // one look ahead cell on the search stack
+    int x;
+    int y;
+    long cell;                      // index of x, y in check_mark & check_bound
+    int depth;
+    int dir;                        // next direction to look in
+};
+
+#ifndef LIBMAZE
+static char     *view        = NULL;       // the maze as the render thread last saw it
+static uint32_t *screen      = NULL;       // shadow frame, what's on the screen for each maze location (and whether it's dirty)
+static int      *dirty_list  = NULL;       // locations changed since the last frame
+static int       num_dirty   = 0;
+static int       redraw      = 1;          // the whole maze changed without being marked dirty
+static int       screen_height = 0;        // the size of maze they're for
+static int       screen_width  = 0;
+#endif
+
+struct tree_type {                  // one cell on the way down the tree from analyze_tree()'s root
+    int x;
+    int y;
+    int back;                       // direction back up the tree (-1 at the root)
+    int dir;                        // next direction to look in
+    int turns;                      // along the passage it's on, since the last dead end or fork
+    int down;                       // longest way down the tree from it, in steps
+    int top;                        // and to a cell in the top row, and in the bottom row (NO_ROW if none)
+    int bottom;
+};
+
+struct journal_type {               // a path the solver changed, to be changed back by restore_maze()
+    int x;
+    int y;
+};
+
+#ifndef LIBMAZE
+static struct change_type {                // a maze location carving changed, on its way to the render thread
+    int x;
+    int y;
+    int val;
+} *ring = NULL;
+
+static unsigned long ring_head = 0;        // next change to be added (only written by the carving thread)
+static unsigned long ring_tail = 0;        // next change to be drawn (only written by the render thread)
+static int       ring_lost   = 0;          // changes were dropped while the ring was full, the view needs to be resynced
+static int       rendering   = 0;          // render thread running
+static int       render_stop = 0;
+static pthread_t render_tid;
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  render_cond;        // signalled to stop the render thread before its next frame is due
+static char     *frame       = NULL;       // escape sequences & characters making up the next frame
+static size_t    frame_len   = 0;
+static size_t    frame_size  = 0;
+#endif
+
+struct stats_type {                 // what making mazes took, for --stats
+    long mazes;
+    long look_aheads;
+    long depth_hist[MAX_DEPTH + 1]; // look aheads by the most cells they got down a path (0 if ruled out up front)
+    long depth_drops;               // times find_directions() gave up on path_depth and tried one less
+    long orphans;                   // directions ruled out for leaving a 1x1 orphan
+    long checks_exceeded;           // look aheads that ran out of checks
+    long path_starts;               // find_path_start() calls
+    long start_words;               // words of the frontier index they scanned (each covering 64 cells)
+    long max_start_words;
+    long diameter;                  // cells on the longest way between any two cells (of any maze, for the run)
+    long longest_through;           // and between the top & bottom rows, the longest way through openings could give
+    long straights;                 // cells with two ways out, straight on
+    long corners;                   // and turning
+    long ways_hist[5];              // cells by ways out, dead ends having one
+    long turn_hist[TURN_BUCKETS];   // passages between dead ends & forks by the turns along them
+    double phase_secs[NUM_PHASES];
+};
+
+static int fps      = 0;
+
+#ifndef LIBMAZE                     // the utility's settings
+static const char *phase_names[NUM_PHASES] = { "initialize", "carve", "push", "analyze", "openings", "solve" };
+
+static struct stats_type run_stats;
+static int stats_on = 0;
+
+static struct bench_size {
+    int height;
+    int width;
+} bench_sizes[] = { { 50, 20 }, { 100, 40 }, { 200, 70 }, { 300, 100 } };
+
+static int bench_depths[] = { 0, 1, 5, 20, 100 };
+
+static int blank    = 0;
+static int jobs     = 1;
+static int format   = ASCII_FORMAT;
+static int cell_px  = 1;                   // image pixels across a cell
+#endif
+
+// Everything about making and solving one maze, so several can be made at once, each by its own thread
+struct maze_ctx {
+    int width;
+    int height;
+    int depth;
+    int seed;
+    int threads;
+    int solver;
+    int rng;                        // RAND_RNG or PCG_RNG
+    int limit_checks;
+    int tile;                       // carve in tiles this many cells square, in parallel, or 0 for all at once
+    maze_watch_fn *watch;           // told of each change, for maze_watch()
+    void *watch_arg;
+
+    int32_t  rand_tbl[31];          // RAND_RNG state, the additive feedback generator behind glibc's rand()
+    int      rand_front;
+    int      rand_rear;
+    uint64_t pcg_state;             // PCG_RNG state
+
+    int max_x;
+    int max_y;
+    int beg_x, end_x;
+    int beg_y, end_y;
+
+    char  *maze_grid;               // allocation holding the maze, including the guard band
+    grid_t maze_cells;              // location 0, 0 of the maze
+    long   maze_stride;             // distance between rows (of blocks, in a blocked maze)
+    size_t maze_size;
+#ifdef  COMPACT_MAZE
+    struct overlay_type maze_overlay;
+    uint64_t *wall_plane[3];        // one bit per cell, right wall and down wall of each maze location
+    long      plane_stride;         // bits between rows of a plane
+#endif
+    struct dir_tbl_type dir_tbl[4];
+
+    struct survey_type *survey_tbl;
+    int next_start;                 // next top opening to be surveyed (shared by all search threads)
+
+    uint64_t *frontier_bits;        // one bit per cell, set while a new path could start there
+    uint64_t *frontier_rows;        // one bit per row, set while the row has any such cells
+    int      *frontier_cnt;         // number of them in each row
+    long      frontier_words;       // words per row of frontier_bits
+    size_t    frontier_size;
+    int       num_frontier;
+    int       frontier_on;          // only kept up to date while carving
+
+    uint8_t  *cell_mask;            // for each cell (the moat's too), which walls are open and which neighbouring cells aren't walls
+    size_t    mask_size;
+
+    struct check_type *check_stack;
+    uint8_t  *check_mark;           // cells on the look ahead stack (1) or flooded (2)
+    uint8_t  *check_bound;          // if not 0, a depth known to be too deep to look ahead from this cell
+    int      *check_queue;          // flood fill queue
+    size_t    check_size;
+
+    struct journal_type *journal;
+    long      num_journal;
+    long      journal_size;
+
+    struct tree_type *tree_stack;
+    long      tree_size;
+
+    long   *solve_parent;           // cell each cell was reached from (-1 if not yet), or for dead end filling its open passages
+    long   *solve_queue;            // cells waiting to be looked at, a fifo or (A*) a heap
+    long   *solve_path;             // the way through, cells from the top opening to the bottom one
+    int    *solve_cost;             // A* cost so far to each cell
+    size_t  solve_size;
+
+    int path_len;
+    int maze_len;
+    int turn_cnt;
+    int solves;
+    int path_depth;
+    int num_checks;
+    int max_checks;
+    int num_check_exceeded;
+    int num_paths;
+    int num_solves;
+    int num_wall_push;
+    int max_path_length;
+    int path_bound;                 // max_path_length is only longest_through, what the openings could give at most
+    int num_maze_created;
+    int has_maze;                   // maze_create() has carved one, that the library can find openings for & solve
+    int unseen;                     // a tile's, in coordinates of its own, so none of its changes are drawn
+
+    double phase_secs[NUM_PHASES];  // how long each phase took for the last maze
+    struct stats_type stats;
+};
+static int  spec_try  = 0;                 // seed (as an offset) this speculative --path worker is making a maze from
+static int *spec_best = NULL;              // lowest seed offset any worker has made a long enough path from, or NULL if not a worker
 
 #define min(x,y)            ({ typeof(x) _x = (x), _y = (y); (_x < _y) ? _x : _y; })
 #define max(x,y)            ({ typeof(x) _x = (x), _y = (y); (_x > _y) ? _x : _y; })
 
+#if !defined(COMPACT_MAZE) && !defined(BLOCKED_MAZE)
+#define grid_at(ctx, g, x, y) ((g)[(long)(x)*(ctx)->maze_stride + (y)])
+#elif !defined(COMPACT_MAZE)
+#define BLOCK_MASK          ((1 << BLOCK_BITS) - 1)
+
+static long block_pos(struct maze_ctx *ctx, int x, int y)  // square blocks of locations, the blocks row by row
+{
+    x += GUARD;
+    y += GUARD;
+    return ((x >> BLOCK_BITS)*ctx->maze_stride + ((long)(y >> BLOCK_BITS) << 2*BLOCK_BITS) + ((x & BLOCK_MASK) << BLOCK_BITS) + (y & BLOCK_MASK));
+}
+#define grid_at(ctx, g, x, y) ((g)[block_pos(ctx, x, y)])
+#endif
+#ifndef COMPACT_MAZE
+#define get_grid(ctx, g, x, y) grid_at(ctx, g, x, y)
+#define set_grid(ctx, g, x, y, v) (grid_at(ctx, g, x, y) = (v))
+#endif
+#define plane_cols(max_y)   ((((max_y) + 2*GUARD + 1)/2 + 63) & ~63)    // bits per row of a bit-plane
+#define plane_rows(max_x)   (((max_x) + 2*GUARD + 1)/2)
+#define maze(x, y)          get_grid(ctx, ctx->maze_cells, x, y)
+#define set_maze(x, y, v)   set_grid(ctx, ctx->maze_cells, x, y, v)
+
 #define is_even(x)          (((x) & 1) == 0)
 #define is_odd(x)           (((x) & 1) == 1)
 
+#define mask_cell(x, y)     ((x)/2*(long)(ctx->width + 2) + (y)/2) // cells from the top left of the moat, row by row
+#define OPEN_WALL(n)        (1 << (n))                      // cell_mask bits for each direction, in solve_tbl order
+#define OPEN_CELL(n)        (16 << (n))
+#define can_carve(m)        (~((m) | (m) >> 4) & 15)        // directions with both the wall and the cell beyond walls
+
 #define set_position(x, y)  printf("\033[%d;%dH", x, y)
 #define set_line_draw()     printf("\033(0")
 #define clr_line_draw()     printf("\033(B")
@@ -130,8 +470,12 @@ int num_maze_created = 0;
 #define set_solved()        printf("\033[32m\033[1m")
 #define clr_solved()        printf("\033[30m\033[0m")
 
+#define SOLVED_GLYPH        (1U << 24)                      // glyph flags, along with up to three characters
+#define DIRTY_GLYPH         (1U << 25)
 
-void get_console_size(int *rows, int *cols)
+
+#ifndef LIBMAZE
+static void get_console_size(int *rows, int *cols)
 {
     struct termios org_terminal;
     struct termios raw_terminal;
@@ -151,461 +495,4067 @@ void get_console_size(int *rows, int *cols)
 
     tcsetattr(STDIN_FILENO, TCSANOW, &org_terminal);
 }
+#endif
 
 
-void initialize_maze(int *x, int *y)
+static char *alloc_grid(size_t size)
 {
-    int i, j;
+#ifdef  _WIN32
+    return (_aligned_malloc(size, ROW_ALIGN));      // no mmap, and no aligned_alloc to go with free()
+#else
+    char *grid;
+
+    if (size < HUGE_GRID)
+        return (aligned_alloc(ROW_ALIGN, size));
+
+    grid = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (grid == MAP_FAILED)
+        return (NULL);
+#ifdef  MADV_HUGEPAGE
+    madvise(grid, size, MADV_HUGEPAGE);
+#endif
+    return (grid);
+#endif
+}
+
+static void free_grid(char *grid, size_t size)
+{
+#ifdef  _WIN32
+    _aligned_free(grid);
+#else
+    if (size < HUGE_GRID)
+        free(grid);
+    else if (grid)
+        munmap(grid, size);
+#endif
+}
 
-    max_x = 2*(height + 1) + 1;
-    max_y = 2*(width  + 1) + 1;
+#ifndef COMPACT_MAZE
+// Sizes the maze for the current height & width, with a guard band of paths all the way around it.  A blocked
+// maze keeps each square block of locations together, so a step up or down is usually in the same cache
+// line as a step across, and its stride is the distance between rows of blocks.
+static void allocate_maze(struct maze_ctx *ctx)
+{
+#ifndef BLOCKED_MAZE
+    long   stride = (ctx->max_y + 2*GUARD + ROW_ALIGN - 1) & ~(ROW_ALIGN - 1);
+    size_t size   = stride * (size_t)(ctx->max_x + 2*GUARD);
+    long   first  = GUARD*stride + GUARD;
+#else
+    long   stride = (long)((ctx->max_y + 2*GUARD + BLOCK_MASK) >> BLOCK_BITS) << 2*BLOCK_BITS;
+    size_t size   = stride * (size_t)((ctx->max_x + 2*GUARD + BLOCK_MASK) >> BLOCK_BITS);
+    long   first  = 0;                              // (block_pos() takes care of the guard band)
+#endif
 
-    for (i = 1; i < max_x - 1; i++) {
-        for (j = 1; j < max_y - 1; j++) {
-            maze[i][j] = WALL;
+    if (size != ctx->maze_size) {
+        free_grid(ctx->maze_grid, ctx->maze_size);
+        if (!(ctx->maze_grid = alloc_grid(size))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
         }
+        ctx->maze_size = size;
     }
-    for (i = 0; i < max_x; i++) maze[i][0] = maze[i][2*(width  + 1)] = PATH;
-    for (j = 0; j < max_y; j++) maze[0][j] = maze[2*(height + 1)][j] = PATH;
+    ctx->maze_stride = stride;
+    ctx->maze_cells  = ctx->maze_grid + first;
+    memset(ctx->maze_grid, PATH, ctx->maze_size);
+}
+
+static grid_t new_trial(struct maze_ctx *ctx)              // private copy of the maze to solve on
+{
+    char *grid = alloc_grid(ctx->maze_size);
 
-    *x = 2*((rand() % height) + 1); // random location
-    *y = 2*((rand() % width ) + 1); // for first path
+    return (grid ? grid + (ctx->maze_cells - ctx->maze_grid) : NULL);
+}
 
-    beg_x =  2;                     // these will
-    end_x =  2*height;              // never change
+static void reset_trial(struct maze_ctx *ctx, grid_t trial)
+{
+    memcpy(trial - (ctx->maze_cells - ctx->maze_grid), ctx->maze_grid, ctx->maze_size);
 }
 
+static void free_trial(struct maze_ctx *ctx, grid_t trial)
+{
+    free_grid(trial - (ctx->maze_cells - ctx->maze_grid), ctx->maze_size);
+}
+#else
+// A compact maze stores only whether each location is a wall, in three bit-planes (cells, right walls and
+// down walls, the posts between walls are always walls), with any SOLVED, TRIED or CHECK state kept in a
+// sparse overlay of two bit states on top.  Trial copies for the opening search share the walls and only
+// have an overlay of their own.  That's the walls in under half a byte a cell, against about four, but carving's
+// state for each cell isn't packed: a byte of cell_mask, and two more of check_mark & check_bound when looking
+// ahead (they aren't allocated at depth 0).  Every step carving takes and every cell a look ahead tries reads
+// them with a single byte load; cell_mask's eight bits would be six scattered loads from the planes, and
+// check_bound holds depths up to MAX_DEPTH, which don't fit in less than a byte either.  So a compact maze only
+// takes about a third of the memory at depth 0, and about half at any other depth (17.5 against 49.5 MB, and
+// 34.6 against 66.6 MB looking ahead, for 3000 x 3000), not the 1/16 or so the walls alone would give.
+#define plane_pos(x, y)     ((((long)(x) + GUARD) >> 1)*ctx->plane_stride + (((y) + GUARD) >> 1))
+#define plane_type(x, y)    (((((x) + GUARD) & 1) << 1) | (((y) + GUARD) & 1))
+#define PAGE_WORDS          ((1 << PAGE_BITS)/32)
 
-void restore_maze(void)
+static int get_grid(struct maze_ctx *ctx, grid_t g, int x, int y)
 {
-    int i, j;
+    int       type = plane_type(x, y);
+    long      pos  = plane_pos (x, y);
+    long      slot = pos*3 + type;
+    uint64_t *page;
+    int       state;
+
+    if (type == 3)                                  // a post, always a wall inside the border
+        return ((unsigned)(x - 1) < (unsigned)(ctx->max_x - 2) && (unsigned)(y - 1) < (unsigned)(ctx->max_y - 2));
+
+    if ((page = g->page[slot >> PAGE_BITS]) != NULL &&
+        (state = (page[(slot >> 5) % PAGE_WORDS] >> 2*(slot & 31)) & 3) != 0)
+        return (state_tbl[state]);
 
-    for (i = 0; i < max_x; i++) {
-        for (j = 0; j < max_y; j++) {
-            if (maze[i][j] == SOLVED ||
-                maze[i][j] == TRIED)
-                maze[i][j] =  PATH;
+    return ((ctx->wall_plane[type][pos >> 6] >> (pos & 63)) & 1);
+}
+
+static void set_grid(struct maze_ctx *ctx, grid_t g, int x, int y, int val)
+{
+    int       type  = plane_type(x, y);
+    long      pos   = plane_pos (x, y);
+    long      slot  = pos*3 + type;
+    uint64_t *page  = g->page[slot >> PAGE_BITS];
+    uint64_t  state = (val == SOLVED) ? 1 : (val == TRIED) ? 2 : (val == CHECK) ? 3 : 0;
+
+    if (type == 3)
+        return;
+
+    if (state && !page) {
+        if (!(page = calloc(PAGE_WORDS, sizeof(uint64_t))) ||
+            !(g->used = realloc(g->used, (g->num_used + 1) * sizeof(long)))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
         }
+        g->page[slot >> PAGE_BITS]  = page;
+        g->used[g->num_used++]      = slot >> PAGE_BITS;
+    }
+    if (page) {
+        page[(slot >> 5) % PAGE_WORDS] &= ~(3ULL  << 2*(slot & 31));
+        page[(slot >> 5) % PAGE_WORDS] |=  (state << 2*(slot & 31));
     }
+    if (state)
+        return;
+    if (val == WALL) ctx->wall_plane[type][pos >> 6] |=  (1ULL << (pos & 63));
+    else             ctx->wall_plane[type][pos >> 6] &= ~(1ULL << (pos & 63));
 }
 
+static void clear_overlay(grid_t g)
+{
+    long i;
+
+    for (i = 0; i < g->num_used; i++)
+        memset(g->page[g->used[i]], 0, PAGE_WORDS * sizeof(uint64_t));
+}
 
-void print_maze()
+static void size_overlay(struct maze_ctx *ctx, grid_t g, long num_pages)
 {
-    int i, j;
+    long i;
 
-    set_position(0, 0);
-    set_line_draw();
+    for (i = 0; i < g->num_used; i++)
+        free(g->page[g->used[i]]);
+    free(g->page);
+    free(g->used);
+
+    g->page      = calloc(num_pages, sizeof(uint64_t *));
+    g->used      = NULL;
+    g->num_used  = 0;
+    g->num_pages = num_pages;
+    if (!g->page) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+}
 
-    for (i = 1; i < 2 * (height + 1); i++) {                                            // wall intersection point                             // non-intersection point
-        for (j = 1; j < 2 * (width + 1); j++) {                                         // check that there is a path on the diagonal          // check that there is a path adjacent
-            char v = output_lookup[1*(maze[i-1][j] == WALL && ((is_odd(i) && is_odd(j)) ? (maze[i-1][j-1] != WALL || maze[i-1][j+1] != WALL) : (maze[i  ][j-1] != WALL || maze[i  ][j+1] != WALL))) +
-                                   2*(maze[i][j+1] == WALL && ((is_odd(i) && is_odd(j)) ? (maze[i-1][j+1] != WALL || maze[i+1][j+1] != WALL) : (maze[i-1][j  ] != WALL || maze[i+1][j  ] != WALL))) +
-                                   4*(maze[i+1][j] == WALL && ((is_odd(i) && is_odd(j)) ? (maze[i+1][j-1] != WALL || maze[i+1][j+1] != WALL) : (maze[i  ][j-1] != WALL || maze[i  ][j+1] != WALL))) +
-                                   8*(maze[i][j-1] == WALL && ((is_odd(i) && is_odd(j)) ? (maze[i-1][j-1] != WALL || maze[i+1][j-1] != WALL) : (maze[i-1][j  ] != WALL || maze[i+1][j  ] != WALL)))];
-            char s = output_lookup[1*(maze[i-1][j] == maze[i][j]) +
-                                   2*(maze[i][j+1] == maze[i][j]) +
-                                   4*(maze[i+1][j] == maze[i][j]) +
-                                   8*(maze[i][j-1] == maze[i][j])];
-            char l = (is_even(i)  &&  maze[i][j-1] == SOLVED) ? HORIZONTAL : BLANK;
-            char r = (is_even(i)  &&  maze[i][j+1] == SOLVED) ? HORIZONTAL : BLANK;
-            char w = blank ? v : s;
+static void allocate_maze(struct maze_ctx *ctx)
+{
+    long   stride = plane_cols(ctx->max_y);
+    long   rows   = plane_rows(ctx->max_x);
+    size_t size   = 3 * stride/8 * rows;
+    int    type;
 
-            switch (maze[i][j]) {
-                case WALL  :               putchar( w ); if (is_even(j)) { putchar( w ); putchar( w ); }               break;
-                case SOLVED: set_solved(); putchar( l ); if (is_even(j)) { putchar( s ); putchar( r ); } clr_solved(); break;
-                case CHECK :               putchar(' '); if (is_even(j)) { putchar('#'); putchar(' '); }               break;
-                default    :               putchar(' '); if (is_even(j)) { putchar(' '); putchar(' '); }               break;
-            }
+    if (size != ctx->maze_size) {
+        free_grid(ctx->maze_grid, ctx->maze_size);
+        if (!(ctx->maze_grid = alloc_grid(size))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
         }
-        putchar('\n');
+        ctx->maze_size = size;
+        size_overlay(ctx, &ctx->maze_overlay, (3*stride*rows >> PAGE_BITS) + 1);
     }
-    clr_line_draw();
-
-    printf("height=%d, width=%d, seed=%d, max_checks=%d, num_wall_push=%d, num_maze_created=%d, num_solves=%d, maze_len=%d, num_paths=%d, avg_path_length=%d, max_path_length=%d %s\r",
-            height   , width   , seed   , max_checks   , num_wall_push   , num_maze_created   , num_solves   , maze_len   , num_paths   , maze_len/num_paths, max_path_length, blank_line);
+    for (type = 0; type < 3; type++)
+        ctx->wall_plane[type] = (uint64_t *)ctx->maze_grid + type * stride/64 * rows;
 
-    if (delay)
-        ms_sleep(delay);
+    ctx->plane_stride = stride;
+    ctx->maze_cells   = &ctx->maze_overlay;
+    memset(ctx->maze_grid, 0, ctx->maze_size);      // everything a path, with no solver states
+    clear_overlay(ctx->maze_cells);
 }
 
-int check_directions(int x, int y, int val, int depth, int *checks)
+static grid_t new_trial(struct maze_ctx *ctx)
 {
-    int ret = 1;
+    grid_t trial = calloc(1, sizeof(*trial));
 
-    if (depth && *checks < 500000) {
-        ++*checks;
-        if (max_checks < ++num_checks)
-            max_checks =   num_checks;
+    if (trial)
+        size_overlay(ctx, trial, ctx->maze_overlay.num_pages);
+    return (trial);
+}
 
-                maze[x    ][y] =  CHECK;
-        ret = ((maze[x - 1][y] == val && maze[x - 2][y] == val && check_directions(x - 2, y, val, depth - 1, checks)) ||   // look left
-               (maze[x + 1][y] == val && maze[x + 2][y] == val && check_directions(x + 2, y, val, depth - 1, checks)) ||   // look right
-               (maze[x][y - 1] == val && maze[x][y - 2] == val && check_directions(x, y - 2, val, depth - 1, checks)) ||   // look up
-               (maze[x][y + 1] == val && maze[x][y + 2] == val && check_directions(x, y + 2, val, depth - 1, checks)));    // look down
-                maze[x][y    ] =  val;
-    }
-    return (ret);
+static void reset_trial(struct maze_ctx *ctx, grid_t trial)
+{
+    (void)ctx;
+    clear_overlay(trial);
 }
 
-int orphan_1x1(int x, int y)
+static void free_trial(struct maze_ctx *ctx, grid_t trial)
 {
-    return (maze[x - 1][y] == WALL && maze[x - 2][y] == PATH &&     // horizontal (look left & right)
-            maze[x + 1][y] == WALL && maze[x + 2][y] == PATH &&
-            maze[x][y - 1] == WALL && maze[x][y - 2] == PATH &&     // vertical   (look up & down)
-            maze[x][y + 1] == WALL && maze[x][y + 2] == PATH);
+    size_overlay(ctx, trial, 0);
+    free(trial->page);
+    free(trial);
 }
+#endif
 
-int check_orphan(int x, int y, int dx, int dy, int depth)
+// Sizes the index of cells new paths can start from, all empty since there are no paths yet
+static void allocate_frontier(struct maze_ctx *ctx)
 {
-    int orphan = 0;
+    long   words = (ctx->width + 63) / 64;
+    size_t size  = words * (size_t)ctx->height + (ctx->height + 63) / 64;
 
-    if (depth) {                                        // this only makes sense when carving paths, not when solving, and only if we haven't exhausted our search depth
-        maze[x + dx/2][y + dy/2] = PATH;                // temporarily set new path
-        maze[x + dx  ][y + dy  ] = PATH;
+    if (size != ctx->frontier_size) {
+        free(ctx->frontier_bits);
+        free(ctx->frontier_cnt);
+        ctx->frontier_bits = malloc(size * sizeof(uint64_t));
+        ctx->frontier_cnt  = malloc(ctx->height * sizeof(int));
+        if (!ctx->frontier_bits || !ctx->frontier_cnt) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
+        ctx->frontier_size = size;
+    }
+    ctx->frontier_words = words;
+    ctx->frontier_rows  = ctx->frontier_bits + words * ctx->height;
+    ctx->num_frontier   = 0;
+    memset(ctx->frontier_bits, 0, size * sizeof(uint64_t));
+    memset(ctx->frontier_cnt , 0, ctx->height * sizeof(int));
+}
 
-        orphan = orphan_1x1(x + dx - 2, y + dy    ) ||  // check for 1x1 orphans left & right of the new location
-                 orphan_1x1(x + dx + 2, y + dy    ) ||
-                 orphan_1x1(x + dx    , y + dy - 2) ||  // check for 1x1 orphans above & below of the new location
-                 orphan_1x1(x + dx    , y + dy + 2);
+// Sizes cell_mask for the current height & width (initialize_maze() fills it in)
+static void allocate_masks(struct maze_ctx *ctx)
+{
+    size_t size = (ctx->height + 2) * (size_t)(ctx->width + 2);
 
-        maze[x + dx  ][y + dy  ] = WALL;                // restore original walls
-        maze[x + dx/2][y + dy/2] = WALL;
+    if (size != ctx->mask_size) {
+        free(ctx->cell_mask);
+        if (!(ctx->cell_mask = malloc(size))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
+        ctx->mask_size = size;
     }
-    return (orphan);
 }
 
-int look(int heading, int x, int y, int dx, int dy, int n, int val, int depth)
+// Sizes the look ahead's per cell state, forgetting the bounds left over from the last maze
+static void allocate_checks(struct maze_ctx *ctx)
 {
-    int check = 0;
+    size_t size = (ctx->height + 2) * (size_t)(ctx->width + 2); // laid out like cell_mask
 
-    if (maze[x + dx/2][y + dy/2] == val &&
-        maze[x + dx  ][y + dy  ] == val && !check_orphan(x, y, dx, dy, depth) && check_directions(x + dx, y + dy, val, depth, &check)) {
-        dir_tbl[n].x = dx;
-        dir_tbl[n].y = dy;
-        dir_tbl[n].heading = heading;
-        return (1);
+    if (!ctx->depth)                                // nothing to look ahead for
+        return;
+    if (size != ctx->check_size) {
+        free(ctx->check_mark);
+        free(ctx->check_bound);
+        free(ctx->check_queue);
+        free(ctx->check_stack);
+        ctx->check_mark  = malloc(size);
+        ctx->check_bound = malloc(size);
+        ctx->check_queue = malloc((ctx->depth + 2) * 2 * sizeof(int));
+        ctx->check_stack = malloc((ctx->depth + 1) * sizeof(struct check_type));
+        if (!ctx->check_mark || !ctx->check_bound || !ctx->check_queue || !ctx->check_stack) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
+        ctx->check_size = size;
     }
-    return (0);
+    memset(ctx->check_mark , 0, size);
+    memset(ctx->check_bound, 0, size);
 }
 
-int find_directions(int x, int y, int val, int search)
+static struct maze_ctx *new_ctx(void)                      // with the default settings, and no maze yet
 {
-    int n = 0;
+    struct maze_ctx *ctx = calloc(1, sizeof(*ctx));
 
-    num_checks = 0;
-    do {
-        n += look(LEFT , x, y, -2,  0, n, val, search ? path_depth : 0);
-        n += look(RIGHT, x, y,  2,  0, n, val, search ? path_depth : 0);
-        n += look(UP   , x, y,  0, -2, n, val, search ? path_depth : 0);
-        n += look(DOWN , x, y,  0,  2, n, val, search ? path_depth : 0);
-    } while (!n && search && path_depth--);
-    if (path_depth < 0) {
-        path_depth = 0;
+    if (!ctx) {
+        fprintf(stderr, "unable to allocate a maze\n");
+        exit(1);
     }
-    return (n);
+    ctx->threads      = 1;
+    ctx->solver       = DFS_SOLVER;
+    ctx->rng          = RAND_RNG;
+    ctx->limit_checks = MAX_CHECKS;
+    return (ctx);
 }
 
-int straight_thru(int x, int y, int val)
+static void free_ctx(struct maze_ctx *ctx)
 {
-    return ((maze[x - 1][y] == val && maze[x - 2][y] == val &&     // horizontal (look left & right)
-             maze[x + 1][y] == val && maze[x + 2][y] == val) ||
-            (maze[x][y - 1] == val && maze[x][y - 2] == val &&     // vertical   (look up & down)
-             maze[x][y + 1] == val && maze[x][y + 2] == val));
+    free_grid(ctx->maze_grid, ctx->maze_size);
+#ifdef COMPACT_MAZE
+    size_overlay(ctx, &ctx->maze_overlay, 0);
+    free(ctx->maze_overlay.page);
+#endif
+    free(ctx->survey_tbl);
+    free(ctx->frontier_bits);
+    free(ctx->frontier_cnt);
+    free(ctx->cell_mask);
+    free(ctx->check_stack);
+    free(ctx->check_mark);
+    free(ctx->check_bound);
+    free(ctx->check_queue);
+    free(ctx->journal);
+    free(ctx->tree_stack);
+    free(ctx->solve_parent);
+    free(ctx->solve_queue);
+    free(ctx->solve_path);
+    free(ctx->solve_cost);
+    free(ctx);
 }
 
-int find_path_start(int *x, int *y)
+// Each maze has random numbers of its own.  RAND_RNG is the additive feedback generator glibc's rand() uses, seeded
+// the same way, so a maze made from a seed is the one rand() would have made; PCG_RNG is quicker to step.
+static int rng_step(struct maze_ctx *ctx)                  // 0 to RAND_MAX, like rand()
 {
-    path_depth = depth;
-    do {
-        int x_start = rand() % height;
-        int y_start = rand() % width ;
-        int i, j;
-
-        for (i = 0; i < height; ++i) {
-            for (j = 0; j < width; ++j) {
-                *x = 2*((x_start + i) % height + 1);
-                *y = 2*((y_start + j) % width  + 1);
-                if (maze[*x][*y] == PATH && !straight_thru(*x, *y, PATH) && find_directions(*x, *y, WALL, NO_SEARCH)) {
-                    return (1);
-                }
-            }
-        }
-    } while (path_depth--);
-    if (path_depth < 0) {
-        path_depth = 0;
+    uint64_t old = ctx->pcg_state;
+    uint32_t bits;
+    uint32_t rot;
+
+    if (ctx->rng == PCG_RNG) {
+        ctx->pcg_state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        bits = ((old >> 18) ^ old) >> 27;
+        rot  = old >> 59;
+        return (((bits >> rot) | (bits << (-rot & 31))) >> 1);
     }
-    return (0);
+    bits = (uint32_t)ctx->rand_tbl[ctx->rand_front] + (uint32_t)ctx->rand_tbl[ctx->rand_rear];
+    ctx->rand_tbl[ctx->rand_front] = bits;
+    ctx->rand_front = (ctx->rand_front + 1) % 31;
+    ctx->rand_rear  = (ctx->rand_rear  + 1) % 31;
+    return (bits >> 1);
 }
 
-void mark_cell(int x, int y, int val)
+static void seed_rand(struct maze_ctx *ctx, unsigned int seed)
 {
-    if (maze[x][y] != val) {
-        maze[x][y]  = val;
-        if (delay && fps <= 1000 && is_even(x) && is_even(y))
-            print_maze();
+    int32_t word = seed ? seed : 1;
+    int     i;
+
+    if (ctx->rng == PCG_RNG) {                      // as pcg32_srandom() seeds it, with its default stream
+        ctx->pcg_state = (seed + 1442695040888963407ULL) * 6364136223846793005ULL + 1442695040888963407ULL;
+        return;
+    }
+    ctx->rand_tbl[0] = word;
+    for (i = 1; i < 31; i++) {                      // 16807 * word % 2147483647, without overflowing
+        word = 16807 * (long)(word % 127773) - 2836 * (long)(word / 127773);
+        if (word < 0)
+            word += 2147483647;
+        ctx->rand_tbl[i] = word;
     }
+    ctx->rand_front = 3;
+    ctx->rand_rear  = 0;
+    for (i = 0; i < 310; i++)
+        rng_step(ctx);
 }
 
-void carve_path(int *x, int *y)
+static void set_mask(struct maze_ctx *ctx, int x, int y)
 {
-    int n, dir;
+    uint8_t m = 0;
+    int     n;
 
-    path_depth = depth;
-    mark_cell(*x, *y, PATH);
-    while ((n = find_directions(*x, *y, WALL, SEARCH)) != 0) {
-        dir = rand() % n;
-        mark_cell(*x +  dir_tbl[dir].x/2, *y +  dir_tbl[dir].y/2, PATH);
-        mark_cell(*x += dir_tbl[dir].x  , *y += dir_tbl[dir].y  , PATH);
-        maze_len++;
+    for (n = 0; n < 4; n++) {
+        if (maze(x + solve_tbl[n].x/2, y + solve_tbl[n].y/2) != WALL) m |= OPEN_WALL(n);
+        if (maze(x + solve_tbl[n].x  , y + solve_tbl[n].y  ) != WALL) m |= OPEN_CELL(n);
     }
-    if (delay)
-        print_maze();
+    ctx->cell_mask[mask_cell(x, y)] = m;
 }
 
-int follow_path(int *x, int *y) {
-    int last_dir = 0;
+// Location x, y inside the moat just became a wall or stopped being one, which the cells next to it keep track of
+static void update_mask(struct maze_ctx *ctx, int x, int y, int open)
+{
+    uint8_t *m   = &ctx->cell_mask[mask_cell(x, y)];
+    long     row = ctx->width + 2;
+
+#define set_bit(at, bit)    if (open) *(at) |= (bit); else *(at) &= ~(bit)
+    if (is_even(x) && is_even(y)) {                 // a cell, seen from the cells around it
+        set_bit(m + row, OPEN_CELL(0));             // it's in direction 0 of the cell below it, and so on
+        set_bit(m - row, OPEN_CELL(1));
+        set_bit(m +   1, OPEN_CELL(2));
+        set_bit(m -   1, OPEN_CELL(3));
+    } else if (is_odd(x) && is_even(y)) {           // a wall between the cells above & below it
+        set_bit(m + row, OPEN_WALL(0));             // (mask_cell() rounds x down to the cell above)
+        set_bit(m      , OPEN_WALL(1));
+    } else if (is_even(x) && is_odd(y)) {           // a wall between the cells left & right of it
+        set_bit(m +   1, OPEN_WALL(2));
+        set_bit(m      , OPEN_WALL(3));
+    }
+#undef  set_bit
+}
 
-    path_depth = 0;
-    mark_cell(*x, *y, SOLVED);
-    while (beg_x <= *x && *x <= end_x && find_directions(*x, *y, PATH, NO_SEARCH)) {
-        mark_cell(*x +  dir_tbl[0].x/2, *y +  dir_tbl[0].y/2, SOLVED);
-        mark_cell(*x += dir_tbl[0].x  , *y += dir_tbl[0].y  , SOLVED);
-        path_len++;
-        if (last_dir != dir_tbl[0].heading) {
-            last_dir  = dir_tbl[0].heading;
-            turn_cnt++;
+static void initialize_maze(struct maze_ctx *ctx, int *x, int *y)
+{
+    int i, j;
+
+    ctx->max_x = 2*(ctx->height + 1) + 1;
+    ctx->max_y = 2*(ctx->width  + 1) + 1;
+
+    allocate_maze(ctx);
+    allocate_frontier(ctx);
+    allocate_masks(ctx);
+    allocate_checks(ctx);
+
+    for (i = 1; i < ctx->max_x - 1; i++) {
+        for (j = 1; j < ctx->max_y - 1; j++) {
+            set_maze(i, j, WALL);
         }
     }
-    return (*x > end_x);
+    for (i = 0; i < ctx->max_x; i++) { set_maze(i, 0, PATH); set_maze(i, 2*(ctx->width  + 1), PATH); }
+    for (j = 0; j < ctx->max_y; j++) { set_maze(0, j, PATH); set_maze(2*(ctx->height + 1), j, PATH); }
+
+    *x = 2*((rng_step(ctx) % ctx->height) + 1); // random location
+    *y = 2*((rng_step(ctx) % ctx->width ) + 1); // for first path
+
+    ctx->beg_x =  2;                // these will
+    ctx->end_x =  2*ctx->height;    // never change
+
+    ctx->num_journal = 0;
+    for (i = 0; i < ctx->max_x; i += 2)
+        for (j = 0; j < ctx->max_y; j += 2)
+            set_mask(ctx, i, j);
 }
 
-void back_track_path(int *x, int *y) {
-    int last_dir = 0;
 
-    path_depth = 0;
-    mark_cell(*x, *y, TRIED);
-    while (!find_directions(*x, *y, PATH, NO_SEARCH) && find_directions(*x, *y, SOLVED, NO_SEARCH)) {
-        mark_cell(*x +  dir_tbl[0].x/2, *y +  dir_tbl[0].y/2, TRIED);
-        mark_cell(*x += dir_tbl[0].x  , *y += dir_tbl[0].y  , TRIED);
-        path_len--;
-        if (last_dir != dir_tbl[0].heading) {
-            last_dir  = dir_tbl[0].heading;
-            turn_cnt--;
+// Solving only ever turns paths into SOLVED or TRIED, so remembering which paths were turned is enough to undo it
+static void journal_maze(struct maze_ctx *ctx, int x, int y)
+{
+    if (ctx->num_journal == ctx->journal_size) {
+        ctx->journal_size = max(2*ctx->journal_size, 1024L);
+        if (!(ctx->journal = realloc(ctx->journal, ctx->journal_size * sizeof(*ctx->journal)))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
         }
     }
+    ctx->journal[ctx->num_journal].x = x;
+    ctx->journal[ctx->num_journal].y = y;
+    ctx->num_journal++;
 }
 
-void solve_maze(int *x, int *y)
+static void restore_maze(struct maze_ctx *ctx)
 {
-    path_len = 0;
-    turn_cnt = 0;
+    while (ctx->num_journal > 0) {
+        ctx->num_journal--;
+        set_maze(ctx->journal[ctx->num_journal].x, ctx->journal[ctx->num_journal].y, PATH);
+    }
+}
+
+
+// The utility draws on its terminal from a render thread of its own; the library leaves drawing to maze_watch()
+#ifndef LIBMAZE
+#define view_at(x, y)       view[(long)(x)*ctx->max_y + (y)]
+
+// What's drawn for maze location i, j of the view (one character wide for odd j, three for even j)
+static uint32_t maze_glyph(struct maze_ctx *ctx, int i, int j)
+{                                                                                   // wall intersection point                             // non-intersection point
+    char v = output_lookup[1*(view_at(i-1, j) == WALL && ((is_odd(i) && is_odd(j)) ? (view_at(i-1, j-1) != WALL || view_at(i-1, j+1) != WALL) : (view_at(i  , j-1) != WALL || view_at(i  , j+1) != WALL))) +   // check that there is a path on the diagonal
+                           2*(view_at(i, j+1) == WALL && ((is_odd(i) && is_odd(j)) ? (view_at(i-1, j+1) != WALL || view_at(i+1, j+1) != WALL) : (view_at(i-1, j  ) != WALL || view_at(i+1, j  ) != WALL))) +   // check that there is a path adjacent
+                           4*(view_at(i+1, j) == WALL && ((is_odd(i) && is_odd(j)) ? (view_at(i+1, j-1) != WALL || view_at(i+1, j+1) != WALL) : (view_at(i  , j-1) != WALL || view_at(i  , j+1) != WALL))) +
+                           8*(view_at(i, j-1) == WALL && ((is_odd(i) && is_odd(j)) ? (view_at(i-1, j-1) != WALL || view_at(i+1, j-1) != WALL) : (view_at(i-1, j  ) != WALL || view_at(i+1, j  ) != WALL)))];
+    char s = output_lookup[1*(view_at(i-1, j) == view_at(i, j)) +
+                           2*(view_at(i, j+1) == view_at(i, j)) +
+                           4*(view_at(i+1, j) == view_at(i, j)) +
+                           8*(view_at(i, j-1) == view_at(i, j))];
+    char l = (is_even(i)  &&  view_at(i, j-1) == SOLVED) ? HORIZONTAL : BLANK;
+    char r = (is_even(i)  &&  view_at(i, j+1) == SOLVED) ? HORIZONTAL : BLANK;
+    char w = blank ? v : s;
+    uint32_t glyph;
+
+    switch (view_at(i, j)) {
+        case WALL  : glyph =                w  | (w   << 8) | (w   << 16); break;
+        case SOLVED: glyph = SOLVED_GLYPH | l  | (s   << 8) | (r   << 16); break;
+        case CHECK : glyph =               ' ' | ('#' << 8) | (' ' << 16); break;
+        default    : glyph =               ' ' | (' ' << 8) | (' ' << 16); break;
+    }
+    return (is_even(j) ? glyph : glyph & (SOLVED_GLYPH | 0xff));
+}
 
-    maze[beg_x - 1][beg_y] = SOLVED;
-    while (!follow_path(x, y)) {
-        back_track_path(x, y);
+static void add_frame(struct maze_ctx *ctx, const char *str, int len)
+{
+    if (frame_len + len > frame_size) {
+        frame_size = 2*(frame_len + len);
+        if (!(frame = realloc(frame, frame_size))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
     }
-    maze[end_x + 1][end_y] = SOLVED;
-    solves++;
+    memcpy(frame + frame_len, str, len);
+    frame_len += len;
 }
 
-void create_openings(int *x, int *y)
+// Redraws location i, j if it changed since it was last drawn, moving the cursor there if it's not already
+static void draw_glyph(struct maze_ctx *ctx, int i, int j, int *line, int *col, int *solved)
 {
-    beg_y = *x;
-    end_y = *y;
+    int      n     = (i - 1)*(2*ctx->width + 1) + j - 1;
+    int      pos   = 1 + 4*((j - 1)/2) + ((j - 1) & 1);
+    uint32_t glyph = maze_glyph(ctx, i, j);
+    char     buf[32];
 
-    maze[beg_x - 1][beg_y] = PATH;
-    maze[end_x + 1][end_y] = PATH;
+    if ((screen[n] & ~DIRTY_GLYPH) == glyph) {
+        screen[n] = glyph;
+        return;
+    }
+    screen[n] = glyph;
+
+    if (*line != i || *col != pos)
+        add_frame(ctx, buf, sprintf(buf, "\033[%d;%dH", i, pos));
+    if (*solved != !!(glyph & SOLVED_GLYPH))
+        add_frame(ctx, (*solved = !*solved) ? "\033[32m\033[1m" : "\033[30m\033[0m", 9);
 
-    *x = beg_x;
-    *y = beg_y;
+    buf[0] = glyph;
+    buf[1] = glyph >>  8;
+    buf[2] = glyph >> 16;
+    add_frame(ctx, buf, is_even(j) ? 3 : 1);
+    *line = i;
+    *col  = pos + (is_even(j) ? 3 : 1);
 }
 
-void delete_openings(void)
+static void allocate_screen(struct maze_ctx *ctx)          // the screen starts out cleared
 {
-    maze[beg_x - 1][beg_y] = WALL;
-    maze[end_x + 1][end_y] = WALL;
+    int i, j;
+
+    if (screen && screen_height == ctx->height && screen_width == ctx->width)
+        return;
+    if (screen) {                                   // a maze of another size (read from a file), so start over
+        free(view);
+        free(screen);
+        free(dirty_list);
+        clr_screen();
+    }
+    screen_height = ctx->height;
+    screen_width  = ctx->width;
+    if (!(view       = malloc((long)ctx->max_x * ctx->max_y)) ||
+        !(screen     = malloc((2*ctx->height + 1) * (2*ctx->width + 1) * sizeof(uint32_t))) ||
+        !(dirty_list = malloc((2*ctx->height + 1) * (2*ctx->width + 1) * sizeof(int)))) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    for (i = 1; i < 2 * (ctx->height + 1); i++)
+        for (j = 1; j < 2 * (ctx->width + 1); j++)
+            screen[(i - 1)*(2*ctx->width + 1) + j - 1] = is_even(j) ? ' ' | (' ' << 8) | (' ' << 16) : ' ';
 }
 
-void search_best_openings(int *x, int *y)
+static void copy_view(struct maze_ctx *ctx)
 {
-    int best_path_len = 0;
-    int best_turn_cnt = 0;
-    int best_start    = 2;
-    int best_finish   = 2;
-    int start ;
-    int finish;
     int i, j;
 
-    for (i = 0; i < width; ++i) {
-        for (j = 0; j < width; ++j) {
-            start  = *x = 2*(i + 1);
-            finish = *y = 2*(j + 1);
-            if (maze[beg_x][start  - 1] != WALL && maze[beg_x][start  + 1] != WALL) continue;
-            if (maze[end_x][finish - 1] != WALL && maze[end_x][finish + 1] != WALL) continue;
-            create_openings(x, y);
-            solve_maze(x, y);
-            if (path_len >  best_path_len ||
-               (path_len == best_path_len &&
-                turn_cnt >  best_turn_cnt)) {
-                best_start      = start   ;
-                best_finish     = finish  ;
-                best_turn_cnt   = turn_cnt;
-                best_path_len   = path_len;
-                max_path_length = path_len;
-            }
-            restore_maze();
-            delete_openings();
-            ++num_solves;
-        }
-    }
-    *x = best_start;
-    *y = best_finish;
-    create_openings(x, y);
+    for (i = 0; i < ctx->max_x; i++)
+        for (j = 0; j < ctx->max_y; j++)
+            view_at(i, j) = maze(i, j);
+    redraw = 1;
 }
 
-int mid_wall_opening(int x, int y)
+// Draws the view, either all of it or just where it's been marked dirty, with everything going out in one write
+static void draw_maze(struct maze_ctx *ctx, int all)
 {
-    return (maze[x    ][y    ] == PATH &&
-            maze[x - 1][y - 1] != WALL &&
-            maze[x - 1][y + 1] != WALL &&
-            maze[x + 1][y - 1] != WALL &&
-            maze[x + 1][y + 1] != WALL);
+    int line = 0, col = 0, solved = 0;
+    int n;
+    size_t done;
+    char buf[512];
+
+    if (redraw)
+        all = 1;
+
+    frame_len = 0;
+    add_frame(ctx, "\033(0", 3);                   // line drawing
+    if (all) {                                      // everything, in order
+        for (num_dirty = 0; num_dirty < (2*ctx->height + 1) * (2*ctx->width + 1); num_dirty++)
+            dirty_list[num_dirty] = num_dirty;
+    }
+    for (n = 0; n < num_dirty; n++)
+        draw_glyph(ctx, dirty_list[n] / (2*ctx->width + 1) + 1, dirty_list[n] % (2*ctx->width + 1) + 1, &line, &col, &solved);
+    num_dirty = 0;
+    redraw    = 0;
+    if (solved)
+        add_frame(ctx, "\033[30m\033[0m", 9);
+    add_frame(ctx, "\033(B", 3);
+
+    add_frame(ctx, buf, sprintf(buf, "\033[%d;1H", 2 * (ctx->height + 1)));
+    add_frame(ctx, buf, snprintf(buf, sizeof(buf), "height=%d, width=%d, seed=%d, max_checks=%d, num_check_exceeded=%d, num_wall_push=%d, num_maze_created=%d, num_solves=%d, maze_len=%d, num_paths=%d, avg_path_length=%d, max_path_length%s%d %s\r",
+                                                ctx->height, ctx->width, ctx->seed, ctx->max_checks, ctx->num_check_exceeded, ctx->num_wall_push, ctx->num_maze_created, ctx->num_solves, ctx->maze_len, ctx->num_paths, ctx->maze_len/max(ctx->num_paths, 1), ctx->path_bound ? "<=" : "=", ctx->max_path_length, blank_line));
+
+    fflush(stdout);                                 // anything printed ahead of this frame goes first
+    for (done = 0; done < frame_len; ) {
+        ssize_t ret = write(STDOUT_FILENO, frame + done, frame_len - done);
+        if (ret <= 0)
+            break;
+        done += ret;
+    }
 }
 
-int push_mid_wall_openings()
+static void mark_dirty(struct maze_ctx *ctx, int x, int y) // a location's glyph depends on the 8 around it
 {
-    int moves = 0;
     int i, j;
 
-    for (i = 1; i < 2 * (height + 1); ++i) {
-        for (j = (i & 1) + 1; j < 2 * (width + 1); j += 2) {
-            if (mid_wall_opening(i, j)) {
-                mark_cell(i, j, WALL);
-                if is_odd(i) mark_cell(i, j + 2, PATH);    // push right
-                else         mark_cell(i + 2, j, PATH);    // push down
-                ++moves;
-                ++num_wall_push;
+    for (i = max(x - 1, 1); i <= min(x + 1, 2*ctx->height + 1); i++) {
+        for (j = max(y - 1, 1); j <= min(y + 1, 2*ctx->width + 1); j++) {
+            int n = (i - 1)*(2*ctx->width + 1) + j - 1;
+            if (!(screen[n] & DIRTY_GLYPH)) {
+                screen[n] |= DIRTY_GLYPH;
+                dirty_list[num_dirty++] = n;
             }
         }
     }
-    if (delay)
-        print_maze();
-    return (moves);
 }
 
-void create_maze(int *x, int *y)
+// Carving hands each change to the render thread through a single producer, single consumer ring.  It never
+// waits for it: when the ring is full, changes are dropped until the render thread has caught up and resynced
+// its view from the maze itself.  The fences make sure a dropped change is either seen by that resync or sent.
+static void send_change(int x, int y, int val)
 {
-    max_checks = 0;
-    maze_len   = 0;
-    num_paths  = 0;
+    static int dropping = 0;
+    unsigned long head = ring_head;
 
-    initialize_maze(x, y);
-    do {
-        num_paths++;
-        carve_path(x, y);
-    } while (find_path_start(x, y) != 0);
+    if (dropping) {
+        __sync_synchronize();
+        if (__atomic_load_n(&ring_lost, __ATOMIC_SEQ_CST))
+            return;
+        dropping = 0;
+    }
+    if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+        dropping = 1;
+        __atomic_store_n(&ring_lost, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    ring[head % RING_SIZE].x   = x;
+    ring[head % RING_SIZE].y   = y;
+    ring[head % RING_SIZE].val = val;
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+}
 
-    while (push_mid_wall_openings())
-        ;
+static int receive_changes(struct maze_ctx *ctx)           // brings the view up to date, returning whether anything changed
+{
+    unsigned long tail = ring_tail;
+    unsigned long head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    int changed = 0;
 
-    delay = 0;  // don't print updates while solving for best openings
-    search_best_openings(x, y);
+    if (__atomic_load_n(&ring_lost, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&ring_tail, tail = head, __ATOMIC_RELEASE);
+        __atomic_store_n(&ring_lost, 0, __ATOMIC_SEQ_CST);
+        __sync_synchronize();
+        copy_view(ctx);                             // racing carving, but anything it misses is still to come in the ring
+        changed = 1;
+        head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    }
+    for (; tail != head; tail++) {
+        struct change_type *change = &ring[tail % RING_SIZE];
+
+        if (view_at(change->x, change->y) != change->val) {
+            view_at(change->x, change->y) = change->val;
+            mark_dirty(ctx, change->x, change->y);
+            changed = 1;
+        }
+    }
+    __atomic_store_n(&ring_tail, tail, __ATOMIC_RELEASE);
+    return (changed);
 }
 
-int main(int argc, char *argv[])
+static void *render_thread(void *arg)                      // draws whatever changed, once a frame
 {
-    struct timeval tval;
-    struct option  long_opts[] = {
-        { "blank" , 0, NULL, 'b' },
-        { "depth" , 1, NULL, 'd' },
-        { "fps"   , 1, NULL, 'f' },
-        { "height", 1, NULL, 'h' },
-        { "path"  , 2, NULL, 'p' },
-        { "show"  , 0, NULL, 's' },
-        { "width" , 1, NULL, 'w' },
-        { NULL    , 0, NULL,  0  }
-    };
-    int rows = 24;
-    int cols = 80;
-    int opt  =  0;
-    int path_start_x;
-    int path_start_y;
-    int max_height = MAX_HEIGHT;
-    int max_width  = MAX_WIDTH;
-    int min_path_length = 1;
-    int show = 0;
+    struct maze_ctx *ctx = arg;
+    long period = 1000000000L / min(fps, MAX_FPS);
+    struct timespec next, now;
 
-    get_console_size(&rows, &cols);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    pthread_mutex_lock(&render_lock);
+    while (!render_stop) {
+        if ((next.tv_nsec += period) >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        while (!render_stop && pthread_cond_timedwait(&render_cond, &render_lock, &next) == 0)
+            ;
+        pthread_mutex_unlock(&render_lock);
+        if (receive_changes(ctx))
+            draw_maze(ctx, 0);
 
-    height = max_height = min(MAX_HEIGHT, (rows -= 3)/2);
-    width  = max_width  = min(MAX_WIDTH , (cols -= 1)/4);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec))
+            next = now;                             // fell behind, skip the frames missed
+        pthread_mutex_lock(&render_lock);
+    }
+    pthread_mutex_unlock(&render_lock);
+    if (receive_changes(ctx))                       // the last of it
+        draw_maze(ctx, 0);
+    return (NULL);
+}
 
-    while ((opt = getopt_long(argc, argv, "bd:f:h:p::r:sw:", long_opts, NULL)) != -1) {
-        switch (opt) {
-            case 'd': depth  = atoi(optarg); break;
-            case 'f': fps    = atoi(optarg); break;
-            case 'h': height = atoi(optarg); break;
-            case 'w': width  = atoi(optarg); break;
-            case 'r': seed   = atoi(optarg); break;
-            case 'b': blank  = 1           ; break;
-            case 's': show   = 1           ; break;
-            case 'p': {
-                char *path_arg = optarg;
-                if (!optarg && argv[optind] && argv[optind][0] != '-')
-                    path_arg = argv[optind++];
-                if (path_arg) min_path_length = atoi(path_arg);
-                else          min_path_length = 0;
-                break;
-            }
-            default :
-                printf("%s\nUsage: %s [options]\n%s", UTS_SIGN_ON, argv[0],
-                       "Options:"                                                                                "\n"
-                       "  -f, --fps     <frames per second>  Set refresh rate           (default: none, instant)""\n"
-                       "  -h, --height  <height>             Set maze height            (default: screen height)""\n"
-                       "  -w, --width   <width>              Set maze width             (default: screen width )""\n"
-                       "  -d, --depth   <depth>              Set path search depth      (default: 1            )""\n"
-                       "  -p, --path   [<length>]            Set minimum path length    (default: none         )""\n"
-                       "  -r, --random  <seed>               Set random number seed     (default: current usec )""\n"
-                       "  -s, --show                         Show intermediate results while path length not met""\n"
-                       "  -b, --blank                        Show empty maze as blank vs. lattice work of walls ""\n\n");
-                exit(0);
-                break;
+static void start_render(struct maze_ctx *ctx)
+{
+    pthread_condattr_t attr;
+
+    allocate_screen(ctx);
+    if (!ring) {
+        if (!(ring = malloc(RING_SIZE * sizeof(*ring)))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
         }
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&render_cond, &attr);
     }
+    copy_view(ctx);
+    ring_head = ring_tail = 0;
+    ring_lost = render_stop = 0;
+    rendering = (pthread_create(&render_tid, NULL, render_thread, ctx) == 0);
+}
 
-    if (depth  <  0 || depth  > 100       ) depth  = 100   ;
-    if (fps    <  0 || fps    > 100000    ) fps    = 100000;
-    if (height <= 0 || height > max_height) height = max_height;
-    if (width  <= 0 || width  > max_width ) width  = max_width ;
+static void resync_render(void)                    // the maze changed without sending the changes, draw it all again
+{
+    if (rendering)
+        __atomic_store_n(&ring_lost, 1, __ATOMIC_SEQ_CST);
+}
+
+static void stop_render(void)
+{
+    if (rendering) {
+        pthread_mutex_lock(&render_lock);
+        render_stop = 1;
+        pthread_cond_signal(&render_cond);
+        pthread_mutex_unlock(&render_lock);
+        pthread_join(render_tid, NULL);
+        rendering = 0;
+    }
+}
 
-    if (min_path_length <  0 || min_path_length >= height * width)
-        min_path_length =  0;
+static void print_maze(struct maze_ctx *ctx)
+{
+    allocate_screen(ctx);
+    copy_view(ctx);
+    draw_maze(ctx, 1);
+}
+#else
+#define rendering           0
+#define start_render(ctx)   ((void)0)
+#define stop_render()       ((void)0)
+#define resync_render()     ((void)0)
+#define send_change(x, y, val) ((void)0)
+#endif
 
-    if (min_path_length == 0)
-         min_path_length = min((height * width) / 2, (int)sqrt(height * width) * 10);
+#ifndef LIBMAZE                     // the utility's output formats, and its loader for binary mazes
+typedef uint8_t v16u8 __attribute__((vector_size(16)));
 
-    clr_screen();
-    set_cursor_off();
+#define ROW_PAD             32                              // room past the end of a row for the row kernel to read & write
 
-    do {
-        if (fps) {
-            delay = ((fps > 1000) ? 1000000 : 1000) / fps;
-        }
-        if (num_maze_created++ > 0 || !seed) {
-            gettimeofday(&tval, NULL);
-            seed = tval.tv_usec;
-        }
-        srand(seed);
+static v16u8 load16(const char *p)
+{
+    v16u8 v;
 
-        create_maze(&path_start_x, &path_start_y); if (show) { print_maze(); sleep(1); }
-         solve_maze(&path_start_x, &path_start_y); if (show) { print_maze(); sleep(1); }
+    memcpy(&v, p, sizeof(v));
+    return (v);
+}
 
-    } while (max_path_length < min_path_length);
+static v16u8 lookup16(const char table[16], v16u8 index)  // table[index] for each of 16 indexes < 16
+{
+#if defined(__SSSE3__)
+    return ((v16u8)_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)table), (__m128i)index));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return (vqtbl1q_u8(vld1q_u8((const uint8_t *)table), index));
+#else
+    v16u8 v;
+    int   k;
 
-    print_maze();
-    set_cursor_on();
-    printf("\n");
-    return (0);
+    for (k = 0; k < 16; k++)
+        v[k] = table[index[k]];
+    return (v);
+#endif
 }
 
+static void load_row(struct maze_ctx *ctx, char *row, int x) // maze row x, one byte per location
+{
+#if !defined(COMPACT_MAZE) && !defined(BLOCKED_MAZE)
+    memcpy(row, &maze(x, 0), ctx->max_y);
+#else
+    int y;
+
+    for (y = 0; y < ctx->max_y; y++)
+        row[y] = maze(x, y);
+#endif
+}
+
+// Works out what output_maze() writes for locations 1 to max_y - 2 of row b (between rows a and c) 16 at a time,
+// the same way as the scalar version: walls at intersection points from the walls around them on the diagonal,
+// other walls as - or | and anything else by its value.  Lanes start at an odd location, so even lanes are posts.
+static void output_row(struct maze_ctx *ctx, char *out, const char *a, const char *b, const char *c, int odd_row)
+{
+    const v16u8 wall  = (v16u8){} + WALL;
+    const v16u8 lane  = { 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff };    // odd lanes, even locations
+    const v16u8 dash  = (v16u8){} + '-';
+    const v16u8 bar   = (v16u8){} + '|';
+    int j;
+
+    for (j = 1; j < ctx->max_y - 1; j += 16) {
+        v16u8 is_wall = (v16u8)(load16(b + j) == wall);
+        v16u8 glyph   = bar;
+        v16u8 v;
+
+        if (odd_row) {
+            v16u8 wa  = (v16u8)(load16(a + j    ) == wall);
+            v16u8 wam = (v16u8)(load16(a + j - 1) == wall);
+            v16u8 wap = (v16u8)(load16(a + j + 1) == wall);
+            v16u8 wbm = (v16u8)(load16(b + j - 1) == wall);
+            v16u8 wbp = (v16u8)(load16(b + j + 1) == wall);
+            v16u8 wc  = (v16u8)(load16(c + j    ) == wall);
+            v16u8 wcm = (v16u8)(load16(c + j - 1) == wall);
+            v16u8 wcp = (v16u8)(load16(c + j + 1) == wall);
+            v16u8 index = (1 & wa  & ~(wam & wap)) |
+                          (2 & wbp & ~(wap & wcp)) |
+                          (4 & wc  & ~(wcm & wcp)) |
+                          (8 & wbm & ~(wam & wcm));
+
+            glyph = (lookup16(simple_lookup, index) & ~lane) | (dash & lane);
+        }
+        v = lookup16(state_lookup, load16(b + j) & 15);
+        v = (glyph & is_wall) | (v & ~is_wall);
+        memcpy(out + j - 1, &v, sizeof(v));
+    }
+}
+
+// Writes the maze and its particulars as portable ascii (no VT100 line drawing or escape sequences)
+static void output_maze(struct maze_ctx *ctx, FILE *fp)
+{
+    char *buf = malloc(4 * (ctx->max_y + ROW_PAD)); // three rows of the maze, and one of output
+    char *row[3], *out;
+    int   i, k;
+
+    if (!buf) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    memset(buf, 0, 4 * (ctx->max_y + ROW_PAD));
+    for (k = 0; k < 3; k++)
+        row[k] = buf + k * (ctx->max_y + ROW_PAD);
+    out = buf + 3 * (ctx->max_y + ROW_PAD);
+
+    fprintf(fp, "seed=%d, height=%d, width=%d, depth=%d, beg_y=%d, end_y=%d, max_path_length=%d, num_paths=%d\n",
+                 ctx->seed, ctx->height, ctx->width, ctx->depth, ctx->beg_y, ctx->end_y, ctx->max_path_length, ctx->num_paths);
+
+    load_row(ctx, row[0], 0);
+    load_row(ctx, row[1], 1);
+    for (i = 1; i < 2 * (ctx->height + 1); i++) {
+        char *a = row[(i - 1) % 3];
+        char *b = row[ i      % 3];
+        char *c = row[(i + 1) % 3];
+
+        load_row(ctx, c, i + 1);
+        output_row(ctx, out, a, b, c, is_odd(i));
+        out[ctx->max_y - 2] = '\n';
+        fwrite(out, 1, ctx->max_y - 1, fp);
+    }
+    putc('\n', fp);
+    free(buf);
+}
+
+// Writes the maze's walls, openings and particulars as a binary maze file
+static void write_maze(struct maze_ctx *ctx, FILE *fp)
+{
+    struct maze_header hdr = { .magic = MAZE_MAGIC, .version = MAZE_VERSION, .header_size = sizeof(hdr), .byte_order = BYTE_ORDER_MARK };
+    long      stride = plane_cols(ctx->max_y);
+    long      rows   = plane_rows(ctx->max_x);
+    long      X, Y;
+    int       type;
+    uint64_t *row    = calloc(stride/64, sizeof(uint64_t));
+    char      pad[64] = {};
+
+    if (!row) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    hdr.height             = ctx->height;
+    hdr.width              = ctx->width;
+    hdr.seed               = ctx->seed;
+    hdr.depth              = ctx->depth;
+    hdr.beg_y              = ctx->beg_y;
+    hdr.end_y              = ctx->end_y;
+    hdr.max_path_length    = ctx->max_path_length;
+    hdr.num_paths          = ctx->num_paths;
+    hdr.maze_len           = ctx->maze_len;
+    hdr.num_wall_push      = ctx->num_wall_push;
+    hdr.num_solves         = ctx->num_solves;
+    hdr.max_checks         = ctx->max_checks;
+    hdr.num_check_exceeded = ctx->num_check_exceeded;
+    hdr.plane_stride       = stride;
+    hdr.plane_rows         = rows;
+    hdr.size               = (sizeof(hdr) + 63) / 64 * 64 + 3 * stride/8 * rows;
+
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(pad, (64 - sizeof(hdr) % 64) % 64, 1, fp);
+    for (type = 0; type < 3; type++) {
+        for (X = 0; X < rows; X++) {
+            memset(row, 0, stride/8);
+            for (Y = 0; Y < stride; Y++) {
+                int x = 2*X + (type >> 1) - GUARD;
+                int y = 2*Y + (type &  1) - GUARD;
+
+                if (x < ctx->max_x + GUARD && y < ctx->max_y + GUARD && maze(x, y) == WALL)
+                    row[Y >> 6] |= 1ULL << (Y & 63);
+            }
+            fwrite(row, sizeof(uint64_t), stride/64, fp);
+        }
+    }
+    free(row);
+}
+
+// Images of the maze, PBM (walls only) or PNG (walls, and the way through in a second colour), written a row of
+// pixels at a time straight from the maze.  Cells (and openings) are cell_px pixels across, walls one pixel thick.
+// PNGs are deflated as they go: matches from hash chains over the last 32K of image data (trying the scanlines
+// one and two above first, as rows a cell tall and walls a cell apart repeat them), coded in blocks with Huffman
+// codes of their own.
+#define DEFLATE_WINDOW      32768                           // farthest back a deflate match can look
+#define DEFLATE_BLOCK       32768                           // literals & matches per block, each with its own codes
+#define HASH_BITS           15
+#define MAX_CHAIN           16                              // earlier places with the same next three bytes tried per match
+#define IDAT_SIZE           (1 << 16)                       // PNG image data chunks
+
+struct png_type {                   // a PNG being written
+    FILE     *fp;
+    uint8_t  *data;                 // the last DEFLATE_WINDOW bytes of image data, then the scanline being added
+    long      data_len;
+    long      data_pos;             // image data before data[0]
+    long      row_len;              // scanline bytes, filter byte first
+    long      rows;
+    long      head[1 << HASH_BITS]; // last place each hash of three bytes was seen (-1 if not yet)
+    long      prev[DEFLATE_WINDOW]; // and the place before that with the same hash, for each place in the window
+    uint16_t  sym_len[DEFLATE_BLOCK];   // the block so far: literals (with sym_dist 0) or match lengths
+    uint16_t  sym_dist[DEFLATE_BLOCK];
+    int       num_syms;
+    uint8_t   idat[IDAT_SIZE];      // compressed image data waiting to be written
+    long      num_idat;
+    uint64_t  bits;                 // and bits waiting to fill a byte of it
+    int       num_bits;
+    uint32_t  adler_a, adler_b;     // of the image data
+};
+
+static uint32_t crc_tbl[256];
+
+static const int len_base [29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int len_extra[29] = { 0, 0, 0, 0, 0, 0, 0,  0,  1,  1,  1,  1,  2,  2,  2,  2,  3,  3,  3,  3,  4,  4,  4,   4,   5,   5,   5,   5,   0 };
+static const int clen_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+#define dist_base(d)        ((d) < 4 ? (d) + 1 : ((2 + ((d) & 1)) << ((d)/2 - 1)) + 1)  // codes 0-3 are 1-4, then two for each extra bit
+#define dist_extra(d)       ((d) < 4 ? 0 : (d)/2 - 1)
+
+static uint32_t crc32_of(uint32_t crc, const uint8_t *p, long len)
+{
+    long k;
+    int  n;
+
+    if (!crc_tbl[1]) {
+        for (n = 0; n < 256; n++) {
+            uint32_t c = n;
+
+            for (k = 0; k < 8; k++)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            crc_tbl[n] = c;
+        }
+    }
+    for (crc = ~crc; len-- > 0; p++)
+        crc = crc_tbl[(crc ^ *p) & 0xff] ^ (crc >> 8);
+    return (~crc);
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >>  8;
+    p[3] = v;
+}
+
+static void png_chunk(FILE *fp, const char *type, const uint8_t *data, long len)
+{
+    uint8_t head[8], tail[4];
+
+    put_be32(head, len);
+    memcpy(head + 4, type, 4);
+    put_be32(tail, crc32_of(crc32_of(0, head + 4, 4), data, len));
+    fwrite(head, 1, 8, fp);
+    fwrite(data, 1, len, fp);
+    fwrite(tail, 1, 4, fp);
+}
+
+static void put_bits(struct png_type *png, uint32_t v, int n)      // deflate packs bits from the bottom of each byte up
+{
+    png->bits     |= (uint64_t)v << png->num_bits;
+    png->num_bits += n;
+    while (png->num_bits >= 8) {
+        if (png->num_idat == IDAT_SIZE) {
+            png_chunk(png->fp, "IDAT", png->idat, png->num_idat);
+            png->num_idat = 0;
+        }
+        png->idat[png->num_idat++] = png->bits;
+        png->bits    >>= 8;
+        png->num_bits -= 8;
+    }
+}
+
+static void put_code(struct png_type *png, uint32_t code, int n)   // but Huffman codes from their top bit down
+{
+    uint32_t r = 0;
+    int      k;
+
+    for (k = 0; k < n; k++)
+        r |= ((code >> k) & 1) << (n - 1 - k);
+    put_bits(png, r, n);
+}
+
+// Works out Huffman code lengths of at most limit bits for the n symbols with the given frequencies (halving
+// them until the code fits), and the canonical codes for those lengths.  At least two symbols always get a code,
+// so the code is complete.
+static void huffman_code(const long *freq, int n, int limit, uint8_t *len, uint16_t *code)
+{
+    long     f[2 * 286], w;
+    int      parent[2 * 286], depth[2 * 286];
+    int      count[16] = {}, next[16];
+    int      i, j, k, a, b, nodes, max_len;
+
+    for (i = 0; i < n; i++)
+        f[i] = freq[i];
+    for (i = 0, k = 0; i < n; i++)
+        k += f[i] > 0;
+    for (i = 0; i < n && k < 2; i++)
+        if (!f[i]) { f[i] = 1; k++; }
+    do {
+        for (i = 0; i < n; i++)
+            parent[i] = -1;
+        for (nodes = n; ; nodes++) {                // join the two lightest until there's one tree
+            for (a = b = -1, j = 0; j < nodes; j++) {
+                if (!f[j] || parent[j] >= 0)
+                    continue;
+                if (a < 0 || f[j] < f[a])            { b = a; a = j; }
+                else if (b < 0 || f[j] < f[b])       b = j;
+            }
+            if (b < 0)
+                break;
+            f[nodes] = f[a] + f[b];
+            parent[nodes] = -1;
+            parent[a] = parent[b] = nodes;
+        }
+        for (max_len = 0, i = nodes - 1; i >= 0; i--) {
+            depth[i] = parent[i] < 0 ? 0 : depth[parent[i]] + 1;
+            if (i < n)
+                max_len = max(max_len, f[i] ? depth[i] : 0);
+        }
+        if (max_len > limit)
+            for (i = 0; i < n; i++)
+                f[i] = f[i] ? (f[i] + 1)/2 : 0;
+    } while (max_len > limit);
+
+    for (i = 0; i < n; i++) {
+        len[i] = f[i] ? depth[i] : 0;
+        count[len[i]]++;
+    }
+    count[0] = 0;
+    for (w = 0, k = 1; k < 16; k++)
+        next[k] = w = (w + count[k - 1]) << 1;
+    for (i = 0; i < n; i++)
+        if (len[i])
+            code[i] = next[len[i]]++;
+}
+
+static int len_code(int len)
+{
+    int n;
+
+    for (n = 28; len_base[n] > len; n--)
+        ;
+    return (n);
+}
+
+static int dist_code(int dist)
+{
+    int d;
+
+    for (d = 0; d < 29 && dist_base(d + 1) <= dist; d++)
+        ;
+    return (d);
+}
+
+// Writes out the block so far, with the best Huffman codes for it (themselves Huffman coded, with runs of the
+// same length shortened)
+static void deflate_block(struct png_type *png, int last)
+{
+    long     lfreq[286] = {}, dfreq[30] = {}, cfreq[19] = {};
+    uint8_t  len[286 + 30], clen[19];
+    uint16_t lcode[286], dcode[30], ccode[19];
+    int      runs[286 + 30], extra[286 + 30];
+    int      num_runs = 0, nlit, ndist, nclen;
+    int      i, k, r;
+
+    for (i = 0; i < png->num_syms; i++) {
+        if (png->sym_dist[i]) {
+            lfreq[257 + len_code(png->sym_len[i])]++;
+            dfreq[dist_code(png->sym_dist[i])]++;
+        } else
+            lfreq[png->sym_len[i]]++;
+    }
+    lfreq[256]++;
+    huffman_code(lfreq, 286, 15, len, lcode);
+    huffman_code(dfreq, 30, 15, len + 286, dcode);
+    for (nlit  = 286; len[nlit - 1] == 0; nlit--)
+        ;
+    for (ndist = 30; ndist > 1 && len[286 + ndist - 1] == 0; ndist--)
+        ;
+    memmove(len + nlit, len + 286, ndist);          // the code lengths, all in a row
+
+    for (i = 0; i < nlit + ndist; i += r) {         // as runs: 16 repeats the last 3-6 times, 17 & 18 are 3-10 & 11-138 zeros
+        for (r = 1; i + r < nlit + ndist && len[i + r] == len[i]; r++)
+            ;
+        if (len[i] == 0 && r >= 11)     { r = min(r, 138); runs[num_runs] = 18; extra[num_runs++] = r - 11; }
+        else if (len[i] == 0 && r >= 3) { r = min(r, 10);  runs[num_runs] = 17; extra[num_runs++] = r - 3; }
+        else if (r >= 4)                { r = min(r, 7);   runs[num_runs] = len[i]; extra[num_runs++] = 0;
+                                                           runs[num_runs] = 16; extra[num_runs++] = r - 4; }
+        else                            { r = 1;           runs[num_runs] = len[i]; extra[num_runs++] = 0; }
+    }
+    for (i = 0; i < num_runs; i++)
+        cfreq[runs[i]]++;
+    huffman_code(cfreq, 19, 7, clen, ccode);
+    for (nclen = 19; nclen > 4 && clen[clen_order[nclen - 1]] == 0; nclen--)
+        ;
+
+    put_bits(png, last, 1);
+    put_bits(png, 2, 2);                            // dynamic Huffman codes
+    put_bits(png, nlit - 257, 5);
+    put_bits(png, ndist - 1, 5);
+    put_bits(png, nclen - 4, 4);
+    for (i = 0; i < nclen; i++)
+        put_bits(png, clen[clen_order[i]], 3);
+    for (i = 0; i < num_runs; i++) {
+        put_code(png, ccode[runs[i]], clen[runs[i]]);
+        if (runs[i] >= 16)
+            put_bits(png, extra[i], runs[i] == 16 ? 2 : runs[i] == 17 ? 3 : 7);
+    }
+    for (i = 0; i < png->num_syms; i++) {
+        int l = png->sym_len[i], d = png->sym_dist[i];
+
+        if (!d)
+            put_code(png, lcode[l], len[l]);
+        else {
+            k = len_code(l);
+            put_code(png, lcode[257 + k], len[257 + k]);
+            put_bits(png, l - len_base[k], len_extra[k]);
+            k = dist_code(d);
+            put_code(png, dcode[k], len[nlit + k]);
+            put_bits(png, d - dist_base(k), dist_extra(k));
+        }
+    }
+    put_code(png, lcode[256], len[256]);            // end of block
+    png->num_syms = 0;
+}
+
+static void deflate_symbol(struct png_type *png, int len, int dist)
+{
+    png->sym_len [png->num_syms] = len;
+    png->sym_dist[png->num_syms] = dist;
+    if (++png->num_syms == DEFLATE_BLOCK)
+        deflate_block(png, 0);
+}
+
+#define hash3(p)            ((((p)[0] << 10) ^ ((p)[1] << 5) ^ (p)[2]) & ((1 << HASH_BITS) - 1))
+
+// Compresses the scanline just put at the end of the image data so far
+static void png_row(struct png_type *png)
+{
+    uint8_t *data = png->data;
+    long  beg = png->data_len;
+    long  end = beg + png->row_len;
+    long  i, k, p, d;
+    int   c, tries;
+
+    for (i = beg; i < end; i++) {                   // adler32, reduced often enough not to overflow
+        png->adler_a += data[i];
+        png->adler_b += png->adler_a;
+        if (((i - beg) & 4095) == 4095 || i == end - 1) {
+            png->adler_a %= 65521;
+            png->adler_b %= 65521;
+        }
+    }
+    for (i = beg; i < end; ) {
+        long best = 0, dist = 0;
+        long at   = png->data_pos + i;
+
+        for (c = 1; c <= 2; c++) {                  // the scanlines above
+            if (png->rows >= c && (d = c * png->row_len) <= DEFLATE_WINDOW) {
+                for (k = 0; k < 258 && i + k < end && data[i + k] == data[i + k - d]; k++)
+                    ;
+                if (k > best) { best = k; dist = d; }
+            }
+        }
+        if (i + 2 < end) {                          // and anywhere else the next three bytes were seen
+            for (p = png->head[hash3(data + i)], tries = MAX_CHAIN; p >= 0 && at - p <= DEFLATE_WINDOW && best < 258 && tries--; ) {
+                long q = p - png->data_pos;
+
+                for (k = 0; k < 258 && i + k < end && data[i + k] == data[q + k]; k++)
+                    ;
+                if (k > best) { best = k; dist = at - p; }
+                if (png->prev[p & (DEFLATE_WINDOW - 1)] >= p)
+                    break;
+                p = png->prev[p & (DEFLATE_WINDOW - 1)];
+            }
+        }
+        if (best < 3)
+            best = 1;
+        for (k = 0; k < best; k++, i++, at++) {     // remember where each of these was
+            if (i + 2 < end) {
+                int h = hash3(data + i);
+
+                png->prev[at & (DEFLATE_WINDOW - 1)] = png->head[h];
+                png->head[h] = at;
+            }
+        }
+        if (best >= 3) deflate_symbol(png, best, dist);
+        else           deflate_symbol(png, data[i - 1], 0);
+    }
+    png->rows++;
+    png->data_len = end;
+    if (png->data_len > DEFLATE_WINDOW) {           // keep just the window
+        long drop = png->data_len - DEFLATE_WINDOW;
+
+        memmove(data, data + drop, DEFLATE_WINDOW);
+        png->data_pos += drop;
+        png->data_len  = DEFLATE_WINDOW;
+    }
+}
+
+static void write_image(struct maze_ctx *ctx, FILE *fp)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const uint8_t palette[9]   = { 0xff, 0xff, 0xff,   0x00, 0x00, 0x00,   0xd0, 0x20, 0x20 };
+    struct png_type *png = NULL;
+    long   width   = (long)ctx->width  * cell_px + ctx->width  + 1;
+    long   height  = (long)ctx->height * cell_px + ctx->height + 1;
+    long   row_len = format == PBM_FORMAT ? (width + 7)/8 : 1 + (width + 3)/4;
+    char  *locs    = malloc(ctx->max_y + ROW_PAD);
+    uint8_t *line  = NULL;
+    uint8_t  ihdr[13], adler[4];
+    int    x, y, k;
+    long   p;
+
+    if (format == PNG_FORMAT) {
+        if ((png = malloc(sizeof(*png))) && (png->data = malloc(DEFLATE_WINDOW + row_len)))
+            memset(png->head, 0xff, sizeof(png->head));
+    } else
+        line = malloc(row_len);
+    if (!locs || (format == PNG_FORMAT ? !png || !png->data : !line)) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+
+    if (format == PBM_FORMAT)
+        fprintf(fp, "P4\n# seed=%d, height=%d, width=%d, depth=%d\n%ld %ld\n", ctx->seed, ctx->height, ctx->width, ctx->depth, width, height);
+    else {
+        png->fp       = fp;
+        png->data_len = png->data_pos = 0;
+        png->row_len  = row_len;
+        png->rows     = 0;
+        png->num_syms = 0;
+        png->num_idat = 0;
+        png->bits     = png->num_bits = 0;
+        png->adler_a  = 1;
+        png->adler_b  = 0;
+        put_be32(ihdr, width);
+        put_be32(ihdr + 4, height);
+        ihdr[8]  = 2;                               // bits per pixel
+        ihdr[9]  = 3;                               // from a palette
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;         // deflate, the usual filters, not interlaced
+        fwrite(signature, 1, sizeof(signature), fp);
+        png_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+        png_chunk(fp, "PLTE", palette, sizeof(palette));
+        put_bits(png, 0x78, 8);                     // zlib stream, 32K window
+        put_bits(png, 0x01, 8);
+    }
+
+    for (x = 1; x < ctx->max_x - 1; x++) {
+        uint8_t *row = format == PNG_FORMAT ? png->data + png->data_len : line;
+
+        load_row(ctx, locs, x);
+        memset(row, 0, row_len);                    // a PNG scanline starts with its filter, none
+        for (p = 0, y = 1; y < ctx->max_y - 1; y++) {
+            int v = locs[y] == WALL ? 1 : locs[y] == SOLVED ? 2 : 0;
+
+            for (k = is_odd(y) ? 1 : cell_px; k > 0; k--, p++) {
+                if (format == PBM_FORMAT)
+                    row[p >> 3]       |= (v == 1) << (7 - (p & 7));
+                else
+                    row[1 + (p >> 2)] |= v << (6 - 2*(p & 3));
+            }
+        }
+        for (k = is_odd(x) ? 1 : cell_px; k > 0; k--) {
+            if (format == PBM_FORMAT)
+                fwrite(line, 1, row_len, fp);
+            else {
+                png_row(png);
+                if (k > 1)                          // the next one, a copy of this one
+                    memcpy(png->data + png->data_len, png->data + png->data_len - row_len, row_len);
+            }
+        }
+    }
+
+    if (format == PNG_FORMAT) {
+        deflate_block(png, 1);
+        put_bits(png, 0, (8 - png->num_bits) & 7);  // to a byte boundary
+        put_be32(adler, png->adler_b << 16 | png->adler_a);
+        for (k = 0; k < 4; k++)
+            put_bits(png, adler[k], 8);
+        png_chunk(fp, "IDAT", png->idat, png->num_idat);
+        png_chunk(fp, "IEND", NULL, 0);
+        free(png->data);
+        free(png);
+    }
+    free(line);
+    free(locs);
+}
+
+// Whether location x, y of a binary maze file's walls is a wall (posts aside, which aren't stored)
+static int file_wall(const struct maze_header *hdr, int x, int y)
+{
+    const uint64_t *planes = (const uint64_t *)((const char *)hdr + (sizeof(*hdr) + 63) / 64 * 64);
+    int  type = (((x + GUARD) & 1) << 1) | ((y + GUARD) & 1);
+    long pos  = ((x + GUARD) >> 1)*hdr->plane_stride + ((y + GUARD) >> 1);
+
+    return ((planes[type * hdr->plane_stride/64 * hdr->plane_rows + (pos >> 6)] >> (pos & 63)) & 1);
+}
+
+// Whether a binary maze file's walls are a perfect maze, closed all the way around but for its openings, so
+// solving it can neither leave the maze nor go around in circles.  With every cell a path and one passage
+// fewer than cells, it's a tree if following the wall on the right from a cell gets back where it started after
+// going along every passage twice (any loop, or any part not joined to the rest, and it gets back sooner).
+static int check_tree(const struct maze_header *hdr)
+{
+    static const int dx[4] = { -2, 0, 2, 0 };       // up, right, down & left, clockwise
+    static const int dy[4] = { 0, 2, 0, -2 };
+    int  max_x = 2*(hdr->height + 1) + 1;
+    int  max_y = 2*(hdr->width  + 1) + 1;
+    long passages = 0, steps = 0;
+    int  x, y, k, n, dir, first;
+
+    for (x = 1; x < max_x - 1; x++) {
+        for (y = 1 + is_odd(x); y < max_y - 1; y += 2) {          // walls (and the cells right of them)
+            if (is_even(x) && y + 1 < max_y - 1 && file_wall(hdr, x, y + 1))
+                return (0);
+            if (x == 1 || x == max_x - 2)
+                n = (y == (x == 1 ? hdr->beg_y : hdr->end_y)) != !file_wall(hdr, x, y);
+            else if (y == 1 || y == max_y - 2)
+                n = !file_wall(hdr, x, y);
+            else {
+                passages += !file_wall(hdr, x, y);
+                n = 0;
+            }
+            if (n)                                  // a way out of the maze that isn't an opening (or a closed opening)
+                return (0);
+        }
+    }
+    if (passages != (long)hdr->height * hdr->width - 1)
+        return (0);
+    if (passages == 0)
+        return (1);
+
+#define can_go(x, y, n)     ((unsigned)((x) + dx[n] - 2) <= (unsigned)(max_x - 5) && (unsigned)((y) + dy[n] - 2) <= (unsigned)(max_y - 5) && \
+                             !file_wall(hdr, (x) + dx[n]/2, (y) + dy[n]/2))
+    x = y = 2;
+    for (first = 0; first < 4 && !can_go(x, y, first); first++)
+        ;
+    if (first == 4)
+        return (0);
+    dir = first;
+    do {
+        x += dx[dir];
+        y += dy[dir];
+        for (k = 1; k < 5; k++) {                   // right, ahead, left, then back
+            n = (dir + 6 - k) & 3;
+            if (can_go(x, y, n))
+                break;
+        }
+        dir = n;
+    } while (++steps <= 2*passages && !(x == 2 && y == 2 && dir == first));
+#undef  can_go
+    return (steps == 2*passages);
+}
+
+// Checks the maze at the start of map is one we can read (and solve), returning its header if so
+static struct maze_header *check_maze(char *map, size_t size)
+{
+    struct maze_header *hdr = (struct maze_header *)map;
+
+    if (size < sizeof(*hdr) || memcmp(hdr->magic, MAZE_MAGIC, 4) || hdr->version != MAZE_VERSION || hdr->byte_order != BYTE_ORDER_MARK ||
+        hdr->header_size != sizeof(*hdr) || hdr->height <= 0 || hdr->height > MAX_SIZE || hdr->width <= 0 || hdr->width > MAX_SIZE ||
+        hdr->plane_stride != plane_cols(2*(hdr->width  + 1) + 1) ||
+        hdr->plane_rows   != plane_rows(2*(hdr->height + 1) + 1) ||
+        hdr->size != (sizeof(*hdr) + 63) / 64 * 64 + 3 * hdr->plane_stride/8 * hdr->plane_rows || hdr->size > size)
+        return (NULL);
+    if (is_odd(hdr->beg_y) || hdr->beg_y < 2 || hdr->beg_y > 2*hdr->width ||    // openings in the top & bottom walls
+        is_odd(hdr->end_y) || hdr->end_y < 2 || hdr->end_y > 2*hdr->width || !check_tree(hdr))
+        return (NULL);
+    return (hdr);
+}
+
+// Makes the maze in a binary maze file the current one.  Compact mazes use the walls right where they're
+// mapped, other mazes are unpacked into the usual one byte per location.
+static void load_maze(struct maze_ctx *ctx, struct maze_header *hdr)
+{
+    uint64_t *planes = (uint64_t *)((char *)hdr + (sizeof(*hdr) + 63) / 64 * 64);
+    long      stride = hdr->plane_stride;
+    long      rows   = hdr->plane_rows;
+
+    ctx->height             = hdr->height;
+    ctx->width              = hdr->width;
+    ctx->seed               = hdr->seed;
+    ctx->depth              = hdr->depth;
+    ctx->beg_y              = hdr->beg_y;
+    ctx->end_y              = hdr->end_y;
+    ctx->max_path_length    = hdr->max_path_length;
+    ctx->num_paths          = hdr->num_paths;
+    ctx->maze_len           = hdr->maze_len;
+    ctx->num_wall_push      = hdr->num_wall_push;
+    ctx->num_solves         = hdr->num_solves;
+    ctx->max_checks         = hdr->max_checks;
+    ctx->num_check_exceeded = hdr->num_check_exceeded;
+
+    ctx->max_x = 2*(ctx->height + 1) + 1;
+    ctx->max_y = 2*(ctx->width  + 1) + 1;
+    ctx->beg_x = 2;
+    ctx->end_x = 2*ctx->height;
+    ctx->num_journal = 0;
+#ifdef COMPACT_MAZE
+    int type;
+
+    if (ctx->maze_overlay.num_pages != (3*stride*rows >> PAGE_BITS) + 1)
+        size_overlay(ctx, &ctx->maze_overlay, (3*stride*rows >> PAGE_BITS) + 1);
+    for (type = 0; type < 3; type++)
+        ctx->wall_plane[type] = planes + type * stride/64 * rows;
+
+    ctx->plane_stride = stride;
+    ctx->maze_cells   = &ctx->maze_overlay;
+    clear_overlay(ctx->maze_cells);
+#else
+    int x, y;
+
+    allocate_maze(ctx);
+    for (x = -GUARD; x < ctx->max_x + GUARD; x++) {
+        for (y = -GUARD; y < ctx->max_y + GUARD; y++) {
+            int  type = (((x + GUARD) & 1) << 1) | ((y + GUARD) & 1);
+            long pos  = ((x + GUARD) >> 1)*stride + ((y + GUARD) >> 1);
+
+            if (type == 3)                          // a post, always a wall inside the border
+                set_maze(x, y, ((unsigned)(x - 1) < (unsigned)(ctx->max_x - 2) && (unsigned)(y - 1) < (unsigned)(ctx->max_y - 2)) ? WALL : PATH);
+            else
+                set_maze(x, y, ((planes[type * stride/64 * rows + (pos >> 6)] >> (pos & 63)) & 1) ? WALL : PATH);
+        }
+    }
+#endif
+}
+#endif
+
+#define check_cell(x, y)    mask_cell(x, y)
+
+// Counts the cells connected to x, y, stopping once there are enough.  A pocket of walls too small now always
+// will be, as carving only makes it smaller, so when it is, its count is kept for each of its cells.
+static int flood_cells(struct maze_ctx *ctx, int x, int y, int enough)
+{
+    int n = 1, i, k;
+
+    ctx->check_queue[0] = x;
+    ctx->check_queue[1] = y;
+    ctx->check_mark[check_cell(x, y)] |= 2;
+    for (i = 0; i < n && n < enough; i++) {
+        int cx = ctx->check_queue[2*i];
+        int cy = ctx->check_queue[2*i + 1];
+
+        for (k = 0; k < 4 && n < enough; k++) {
+            int nx = cx + solve_tbl[k].x;
+            int ny = cy + solve_tbl[k].y;
+
+            if ((can_carve(ctx->cell_mask[check_cell(cx, cy)]) & (1 << k)) && !(ctx->check_mark[check_cell(nx, ny)] & 2)) {
+                ctx->check_mark[check_cell(nx, ny)] |= 2;
+                ctx->check_queue[2*n    ] = nx;
+                ctx->check_queue[2*n + 1] = ny;
+                n++;
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        long cell = check_cell(ctx->check_queue[2*i], ctx->check_queue[2*i + 1]);
+
+        ctx->check_mark[cell] &= ~2;
+        if (n < enough && (!ctx->check_bound[cell] || ctx->check_bound[cell] > n))
+            ctx->check_bound[cell] = n;
+    }
+    return (n);
+}
+
+// Depth first search, in the order the recursive version it replaces looked, for a path of depth more cells
+// from x, y that doesn't cross itself, giving up after a limited number of checks and assuming there is one.
+// Once it's clear there's no straight shot, it also sees whether the pocket it's in is big enough at all.
+static int check_directions(struct maze_ctx *ctx, int x, int y, int depth, int *checks)
+{
+    const long step[4] = { -(ctx->width + 2), ctx->width + 2, -1, 1 }; // cell to cell, in solve_tbl order
+    struct check_type *top = ctx->check_stack;      // cells stepped on so far, but the last one
+    uint8_t *mark  = ctx->check_mark;
+    uint8_t *bound = ctx->check_bound;
+    int  flooded   = 0;
+    int  found     = 1;
+    int  cx = x, cy = y, cd = depth, dir = 0;       // the last cell stepped on
+    long cell = check_cell(x, y);
+    int  n = *checks, k, ways;
+    int  low = depth;                               // fewest cells left to go so far
+
+    if (!depth)
+        return (1);
+    ctx->stats.look_aheads++;
+    if (bound[cell] && bound[cell] <= depth) {
+        ctx->stats.depth_hist[0]++;
+        return (0);
+    }
+
+    for (;;) {
+        if (n >= ctx->limit_checks) {               // step onto cx, cy
+            ctx->num_check_exceeded++;
+            ctx->stats.checks_exceeded++;
+            break;
+        }
+        ++n;
+        if (ctx->max_checks < ++ctx->num_checks)
+            ctx->max_checks =   ctx->num_checks;
+        mark[cell] = 1;
+
+        if (!flooded && n > 2*depth) {              // not a straight shot, is there room for it at all
+            flooded = 1;
+            if (flood_cells(ctx, x, y, depth + 1) <= depth) {
+                found = 0;
+                break;
+            }
+        }
+        for (;;) {                                  // look for the next direction to go
+            ways = can_carve(ctx->cell_mask[cell]);
+#define try_dir(i) \
+            if ((ways & (1 << i)) && !mark[cell + step[i]] && \
+                (!bound[cell + step[i]] || bound[cell + step[i]] >= cd)) { k = i; break; }     /* skip where the rest of the path can't fit */ \
+            __attribute__((fallthrough))            // on to the next direction's test
+            switch (dir) {                          // each direction gets its own test (and branch prediction)
+                case 0: try_dir(0);
+                case 1: try_dir(1);
+                case 2: try_dir(2);
+                case 3: try_dir(3);
+                default: k = 4;
+            }
+#undef  try_dir
+            if (k < 4)
+                break;
+            mark[cell] = 0;                         // nowhere left to look from here, back up
+            if (top == ctx->check_stack) {          // nowhere to go from x, y (and never will be)
+                if (!bound[check_cell(x, y)] || bound[check_cell(x, y)] > depth)
+                    bound[check_cell(x, y)] = depth;
+                ctx->stats.depth_hist[depth - low + 1]++;
+                *checks = n;
+                return (0);
+            }
+            top--;
+            cx = top->x; cy = top->y; cell = top->cell; cd = top->depth; dir = top->dir;
+        }
+        if (cd == 1)
+            break;                                  // found a path long enough
+        top->x = cx; top->y = cy; top->cell = cell; top->depth = cd; top->dir = k + 1;
+        top++;
+        cx += solve_tbl[k].x; cy += solve_tbl[k].y; cell += step[k]; cd--; dir = 0;
+        low = min(low, cd);
+    }
+    ctx->stats.depth_hist[depth - low + 1]++;
+    mark[cell] = 0;                                 // unwind the stack
+    while (top-- > ctx->check_stack)
+        mark[top->cell] = 0;
+    *checks = n;
+    return (found);
+}
+
+// Look ahead kernels for the shallowest depths, which most mazes are made with (and deeper look aheads drop to
+// when they can't find a way), doing just what check_directions() would for them, counts and all, without its
+// stack.  At depth 1 there's a way on from x, y if it has anywhere to carve at all.  At depth 2 it's the same for
+// each cell next to it, not counting x, y, until one has, checking the pocket they're in once five cells have
+// been tried, as check_directions() would.
+static int check_depth_1(struct maze_ctx *ctx, int x, int y)
+{
+    int  check = 0;
+    long cell  = check_cell(x, y);
+
+    if (ctx->limit_checks < 1)                      // (only ever from the library)
+        return (check_directions(ctx, x, y, 1, &check));
+    ctx->stats.look_aheads++;
+    if (ctx->check_bound[cell] == 1) {
+        ctx->stats.depth_hist[0]++;
+        return (0);
+    }
+    if (ctx->max_checks < ++ctx->num_checks)
+        ctx->max_checks =   ctx->num_checks;
+    ctx->stats.depth_hist[1]++;
+    if (can_carve(ctx->cell_mask[cell]))
+        return (1);
+    ctx->check_bound[cell] = 1;                     // nowhere to go from x, y (and never will be)
+    return (0);
+}
+
+static int check_depth_2(struct maze_ctx *ctx, int x, int y)
+{
+    const long step[4] = { -(ctx->width + 2), ctx->width + 2, -1, 1 };
+    uint8_t *bound = ctx->check_bound;
+    long     cell  = check_cell(x, y);
+    int      check = 0, n = 1, k, ways;
+    int      found = 0, stepped = 0;
+
+    if (ctx->limit_checks < 1)
+        return (check_directions(ctx, x, y, 2, &check));
+    ctx->stats.look_aheads++;
+    if (bound[cell] && bound[cell] <= 2) {
+        ctx->stats.depth_hist[0]++;
+        return (0);
+    }
+    if (ctx->max_checks < ++ctx->num_checks)
+        ctx->max_checks =   ctx->num_checks;
+    ways = can_carve(ctx->cell_mask[cell]);
+    for (k = 0; k < 4; k++) {
+        long to = cell + step[k];
+
+        if (!(ways & (1 << k)) || bound[to] == 1)   // skip where the rest of the path can't fit
+            continue;
+        stepped = 1;
+        if (n >= ctx->limit_checks) {
+            ctx->num_check_exceeded++;
+            ctx->stats.checks_exceeded++;
+            found = 1;
+            break;
+        }
+        if (ctx->max_checks < ++ctx->num_checks)
+            ctx->max_checks =   ctx->num_checks;
+        if (++n == 5 && flood_cells(ctx, x, y, 3) <= 2)         // not a straight shot, is there room for it at all
+            break;
+        if (can_carve(ctx->cell_mask[to]) & ~(1 << (k ^ 1))) {  // anywhere to go but back
+            found = 1;
+            break;
+        }
+    }
+    ctx->stats.depth_hist[stepped ? 2 : 1]++;
+    if (k == 4 && (!bound[cell] || bound[cell] > 2))
+        bound[cell] = 2;
+    return (found);
+}
+
+// A cell that's walled in on all sides by cells that are paths can never be reached
+#define orphan_1x1(m)       ((m) == (OPEN_CELL(0) | OPEN_CELL(1) | OPEN_CELL(2) | OPEN_CELL(3)))
+
+// Would carving from x, y to the cell in direction n leave any of that cell's neighbours a 1x1 orphan?
+// Carving it only makes the cell a path as far as its neighbours go (x, y itself gets an open wall).
+static int check_orphan(struct maze_ctx *ctx, int x, int y, int n, int depth)
+{
+    long cell = mask_cell(x + solve_tbl[n].x, y + solve_tbl[n].y);
+    const long step[4] = { -(ctx->width + 2), ctx->width + 2, -1, 1 };
+    int  k;
+
+    if (depth) {                                        // this only makes sense when carving paths, not when solving, and only if we haven't exhausted our search depth
+        for (k = 0; k < 4; k++) {
+            if (k != (n ^ 1) && orphan_1x1(ctx->cell_mask[cell + step[k]] | OPEN_CELL(k ^ 1))) {
+                ctx->stats.orphans++;
+                return (1);
+            }
+        }
+    }
+    return (0);
+}
+
+static int look(struct maze_ctx *ctx, int n, int x, int y, int k, int depth)
+{
+    int check = 0;
+    int found;
+
+    if (check_orphan(ctx, x, y, k, depth))
+        return (0);
+    switch (depth) {                                // the shallowest have kernels of their own
+        case 0:  found = 1; break;
+        case 1:  found = check_depth_1(ctx, x + solve_tbl[k].x, y + solve_tbl[k].y); break;
+        case 2:  found = check_depth_2(ctx, x + solve_tbl[k].x, y + solve_tbl[k].y); break;
+        default: found = check_directions(ctx, x + solve_tbl[k].x, y + solve_tbl[k].y, depth, &check); break;
+    }
+    if (found) {
+        ctx->dir_tbl[n] = solve_tbl[k];
+        return (1);
+    }
+    return (0);
+}
+
+static int find_directions(struct maze_ctx *ctx, int x, int y, int val, int search)
+{
+    int ways = 0;
+    int n = 0;
+    int k;
+
+    if (val == WALL)                                // carving keeps track of this for every cell
+        ways = can_carve(ctx->cell_mask[mask_cell(x, y)]);
+    else {
+        for (k = 0; k < 4; k++)
+            if (maze(x + solve_tbl[k].x/2, y + solve_tbl[k].y/2) == val &&
+                maze(x + solve_tbl[k].x  , y + solve_tbl[k].y  ) == val)
+                ways |= 1 << k;
+    }
+    ctx->num_checks = 0;
+    do {
+        for (k = 0; k < 4; k++)
+            if (ways & (1 << k))
+                n += look(ctx, n, x, y, k, search ? ctx->path_depth : 0);
+    } while (!n && search && ctx->path_depth-- && ++ctx->stats.depth_drops); // (counting each try at one less)
+    if (ctx->path_depth < 0) {
+        ctx->path_depth = 0;
+    }
+    return (n);
+}
+
+#define straight_thru(m)    (((m) & 0x33) == 0x33 || ((m) & 0xcc) == 0xcc)     // open walls and paths both ways across or down
+
+// A new path can start from any path that isn't straight through and still has a wall it could be carved into
+static int path_start(struct maze_ctx *ctx, int x, int y)
+{
+    uint8_t m = ctx->cell_mask[mask_cell(x, y)];
+
+    return (maze(x, y) == PATH && !straight_thru(m) && can_carve(m));
+}
+
+static void update_frontier(struct maze_ctx *ctx, int x, int y)
+{
+    int       r    = x/2 - 1;
+    int       c    = y/2 - 1;
+    uint64_t *word = &ctx->frontier_bits[r * ctx->frontier_words + c/64];
+    uint64_t  bit  = 1ULL << (c & 63);
+
+    if (r < 0 || r >= ctx->height || c < 0 || c >= ctx->width || !(*word & bit) == !path_start(ctx, x, y))
+        return;
+
+    *word ^= bit;
+    if (*word & bit) {
+        ctx->num_frontier++;
+        if (ctx->frontier_cnt[r]++ == 0) ctx->frontier_rows[r/64] |=  (1ULL << (r & 63));
+    } else {
+        ctx->num_frontier--;
+        if (--ctx->frontier_cnt[r] == 0) ctx->frontier_rows[r/64] &= ~(1ULL << (r & 63));
+    }
+}
+
+static void mark_frontier(struct maze_ctx *ctx, int x, int y) // a cell only depends on the locations up to 2 away in a straight line
+{
+    if (is_even(x) && is_even(y)) {
+        update_frontier(ctx, x    , y    );
+        update_frontier(ctx, x - 2, y    );
+        update_frontier(ctx, x + 2, y    );
+        update_frontier(ctx, x    , y - 2);
+        update_frontier(ctx, x    , y + 2);
+    } else if (is_even(y)) {
+        update_frontier(ctx, x - 1, y    );
+        update_frontier(ctx, x + 1, y    );
+    } else if (is_even(x)) {
+        update_frontier(ctx, x    , y - 1);
+        update_frontier(ctx, x    , y + 1);
+    }
+}
+
+static long next_bit(struct maze_ctx *ctx, const uint64_t *bits, long n, long start) // first bit set at or after start, wrapping around
+{
+    long     words = (n + 63) / 64;
+    long     i, k;
+    uint64_t word;
+
+    for (i = 0; i <= words; i++) {
+        ctx->stats.start_words++;
+        k    = (start/64 + i) % words;
+        word = bits[k];
+        if (i == 0    ) word &=   ~0ULL << (start & 63);
+        if (i == words) word &= ~(~0ULL << (start & 63));
+        if (word)
+            return (k*64 + __builtin_ctzll(word));
+    }
+    return (-1);
+}
+
+// Picks the first cell a scan of the maze from a random location would have found (rows from a random row,
+// each from a random column), without scanning anything but the frontier index
+static int find_path_start(struct maze_ctx *ctx, int *x, int *y)
+{
+    long words = ctx->stats.start_words;
+
+    ctx->stats.path_starts++;
+    ctx->path_depth = ctx->depth;
+    if (ctx->num_frontier) {
+        int x_start = rng_step(ctx) % ctx->height;
+        int y_start = rng_step(ctx) % ctx->width ;
+        int r = next_bit(ctx, ctx->frontier_rows, ctx->height, x_start);
+        int c = next_bit(ctx, ctx->frontier_bits + r * ctx->frontier_words, ctx->width, y_start);
+
+        ctx->stats.max_start_words = max(ctx->stats.max_start_words, ctx->stats.start_words - words);
+        *x = 2*(r + 1);
+        *y = 2*(c + 1);
+        return (1);
+    }
+    ctx->path_depth = 0;
+    return (0);
+}
+
+static void mark_cell(struct maze_ctx *ctx, int x, int y, int val)
+{
+    int old = maze(x, y);
+
+    if (old != val) {
+        if (old == PATH && (val == SOLVED || val == TRIED))
+            journal_maze(ctx, x, y);
+        set_maze(x, y, val);
+        if ((old == WALL) != (val == WALL))
+            update_mask(ctx, x, y, val != WALL);
+        if (ctx->frontier_on)
+            mark_frontier(ctx, x, y);
+        if (rendering && !ctx->unseen)
+            send_change(x, y, val);
+        if (ctx->watch)
+            ctx->watch(ctx->watch_arg, x, y, val);
+    }
+}
+
+static void carve_path(struct maze_ctx *ctx, int *x, int *y)
+{
+    int n, dir;
+
+    ctx->path_depth = ctx->depth;
+    mark_cell(ctx, *x, *y, PATH);
+    while ((n = find_directions(ctx, *x, *y, WALL, SEARCH)) != 0) {
+        dir = rng_step(ctx) % n;
+        mark_cell(ctx, *x +  ctx->dir_tbl[dir].x/2, *y +  ctx->dir_tbl[dir].y/2, PATH);
+        mark_cell(ctx, *x += ctx->dir_tbl[dir].x  , *y += ctx->dir_tbl[dir].y  , PATH);
+        ctx->maze_len++;
+    }
+}
+
+static int follow_path(struct maze_ctx *ctx, int *x, int *y) {
+    int last_dir = 0;
+
+    ctx->path_depth = 0;
+    mark_cell(ctx, *x, *y, SOLVED);
+    while (ctx->beg_x <= *x && *x <= ctx->end_x && find_directions(ctx, *x, *y, PATH, NO_SEARCH)) {
+        mark_cell(ctx, *x +  ctx->dir_tbl[0].x/2, *y +  ctx->dir_tbl[0].y/2, SOLVED);
+        mark_cell(ctx, *x += ctx->dir_tbl[0].x  , *y += ctx->dir_tbl[0].y  , SOLVED);
+        ctx->path_len++;
+        if (last_dir != ctx->dir_tbl[0].heading) {
+            last_dir  = ctx->dir_tbl[0].heading;
+            ctx->turn_cnt++;
+        }
+    }
+    return (*x > ctx->end_x);
+}
+
+static void back_track_path(struct maze_ctx *ctx, int *x, int *y) {
+    int last_dir = 0;
+
+    ctx->path_depth = 0;
+    mark_cell(ctx, *x, *y, TRIED);
+    while (!find_directions(ctx, *x, *y, PATH, NO_SEARCH) && find_directions(ctx, *x, *y, SOLVED, NO_SEARCH)) {
+        mark_cell(ctx, *x +  ctx->dir_tbl[0].x/2, *y +  ctx->dir_tbl[0].y/2, TRIED);
+        mark_cell(ctx, *x += ctx->dir_tbl[0].x  , *y += ctx->dir_tbl[0].y  , TRIED);
+        ctx->path_len--;
+        if (last_dir != ctx->dir_tbl[0].heading) {
+            last_dir  = ctx->dir_tbl[0].heading;
+            ctx->turn_cnt--;
+        }
+    }
+}
+
+static void solve_dfs(struct maze_ctx *ctx, int *x, int *y)
+{
+    mark_cell(ctx, ctx->beg_x - 1, ctx->beg_y, SOLVED);
+    while (!follow_path(ctx, x, y)) {
+        back_track_path(ctx, x, y);
+    }
+    mark_cell(ctx, ctx->end_x + 1, ctx->end_y, SOLVED);
+}
+
+// The other solvers only read the walls, keeping what they know in their own arrays indexed by cell,
+// and hand back the way through as a list of cells from the top opening to the bottom one
+#define cell_num(x, y)      ((long)((x)/2 - 1)*ctx->width + (y)/2 - 1)
+#define solve_x(n)          (2*((n)/ctx->width + 1))
+#define solve_y(n)          (2*((n)%ctx->width + 1))
+
+static int passage(struct maze_ctx *ctx, int x, int y, int n) // from cell x, y to the next cell in the direction of solve_tbl[n]
+{
+    int nx = x + solve_tbl[n].x;
+    int ny = y + solve_tbl[n].y;
+
+    return (ctx->beg_x <= nx && nx <= ctx->end_x && 2 <= ny && ny <= 2*ctx->width && maze(x + solve_tbl[n].x/2, y + solve_tbl[n].y/2) != WALL);
+}
+
+static void allocate_solve(struct maze_ctx *ctx)
+{
+    size_t cells = (size_t)ctx->height * ctx->width;
+
+    if (ctx->solve_size != cells) {
+        ctx->solve_parent = realloc(ctx->solve_parent, cells * sizeof(*ctx->solve_parent));
+        ctx->solve_queue  = realloc(ctx->solve_queue , cells * sizeof(*ctx->solve_queue ) * 4); // A* can have a cell on its heap once for each way in
+        ctx->solve_path   = realloc(ctx->solve_path  , cells * sizeof(*ctx->solve_path  ));
+        ctx->solve_cost   = realloc(ctx->solve_cost  , cells * sizeof(*ctx->solve_cost  ));
+        ctx->solve_size   = cells;
+        if (!ctx->solve_parent || !ctx->solve_queue || !ctx->solve_path || !ctx->solve_cost) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
+    }
+}
+
+// Walks the parents back from the bottom opening's cell, returning the number of cells on the way through
+static int parent_path(struct maze_ctx *ctx)
+{
+    long cell = cell_num(ctx->end_x, ctx->end_y);
+    int  len  = 0;
+    int  i;
+
+    for (; cell >= 0; cell = ctx->solve_parent[cell])
+        ctx->solve_path[len++] = cell;
+    for (i = 0; i < len/2; i++) {
+        cell = ctx->solve_path[i];
+        ctx->solve_path[i] = ctx->solve_path[len - 1 - i];
+        ctx->solve_path[len - 1 - i] = cell;
+    }
+    return (len);
+}
+
+static int solve_path_bfs(struct maze_ctx *ctx)
+{
+    long start = cell_num(ctx->beg_x, ctx->beg_y);
+    long goal  = cell_num(ctx->end_x, ctx->end_y);
+    long head  = 0;
+    long tail  = 0;
+    long cell, next;
+    int  x, y, n;
+
+    memset(ctx->solve_parent, 0xff, ctx->solve_size * sizeof(*ctx->solve_parent));
+    ctx->solve_parent[start] = start;
+    ctx->solve_queue[tail++] = start;
+    while (head < tail && (cell = ctx->solve_queue[head++]) != goal) {
+        x = solve_x(cell);
+        y = solve_y(cell);
+        for (n = 0; n < 4; n++) {
+            if (passage(ctx, x, y, n) && ctx->solve_parent[next = cell_num(x + solve_tbl[n].x, y + solve_tbl[n].y)] < 0) {
+                ctx->solve_parent[next] = cell;
+                ctx->solve_queue[tail++] = next;
+            }
+        }
+    }
+    ctx->solve_parent[start] = -1;
+    return (parent_path(ctx));
+}
+
+// Fills in dead ends until only the way through is left, then follows it from the top
+static int solve_path_deadend(struct maze_ctx *ctx)
+{
+    long start = cell_num(ctx->beg_x, ctx->beg_y);
+    long goal  = cell_num(ctx->end_x, ctx->end_y);
+    long *open = ctx->solve_parent;                 // bit n set while the passage in the direction of solve_tbl[n] is open
+    long tail  = 0;
+    long cell, next;
+    int  len   = 0;
+    int  x, y, n;
+
+    for (cell = 0; cell < (long)ctx->solve_size; cell++) {
+        open[cell] = 0;
+        for (n = 0; n < 4; n++)
+            if (passage(ctx, solve_x(cell), solve_y(cell), n))
+                open[cell] |= 1 << n;
+        if (cell != start && cell != goal && __builtin_popcountl(open[cell]) <= 1)
+            ctx->solve_queue[tail++] = cell;
+    }
+    while (tail > 0) {
+        cell = ctx->solve_queue[--tail];
+        if (!open[cell])
+            continue;
+        n = __builtin_ctzl(open[cell]);
+        x = solve_x(cell);
+        y = solve_y(cell);
+        next = cell_num(x + solve_tbl[n].x, y + solve_tbl[n].y);
+        open[cell] = 0;
+        open[next] &= ~(1 << (n ^ 1));              // solve_tbl pairs opposite directions
+        if (next != start && next != goal && __builtin_popcountl(open[next]) == 1)
+            ctx->solve_queue[tail++] = next;
+    }
+    for (cell = start, n = -1; len < (long)ctx->solve_size; ) {
+        ctx->solve_path[len++] = cell;
+        if (n >= 0)
+            open[cell] &= ~(1 << (n ^ 1));          // not back the way we came
+        if (cell == goal || !open[cell])
+            break;
+        n = __builtin_ctzl(open[cell]);
+        cell = cell_num(solve_x(cell) + solve_tbl[n].x, solve_y(cell) + solve_tbl[n].y);
+    }
+    return (len);
+}
+
+// A* keeps its heap entries as estimate * cells + cell, so the smallest entry is the best estimate (ties going
+// to the first cell) and an entry left behind by a cheaper way to the same cell can be told apart when it's popped
+#define estimate(cell)      (ctx->solve_cost[cell] + labs(solve_x(cell) - ctx->end_x)/2 + labs(solve_y(cell) - ctx->end_y)/2)
+
+static void heap_push(long *heap, long *len, long entry)
+{
+    long i = (*len)++;
+
+    for (; i > 0 && entry < heap[(i - 1)/2]; i = (i - 1)/2)
+        heap[i] = heap[(i - 1)/2];
+    heap[i] = entry;
+}
+
+static long heap_pop(long *heap, long *len)
+{
+    long top   = heap[0];
+    long entry = heap[--(*len)];
+    long i     = 0;
+    long j;
+
+    while ((j = 2*i + 1) < *len) {
+        if (j + 1 < *len && heap[j + 1] < heap[j])
+            j++;
+        if (entry <= heap[j])
+            break;
+        heap[i] = heap[j];
+        i = j;
+    }
+    heap[i] = entry;
+    return (top);
+}
+
+static int solve_path_astar(struct maze_ctx *ctx)
+{
+    long start = cell_num(ctx->beg_x, ctx->beg_y);
+    long goal  = cell_num(ctx->end_x, ctx->end_y);
+    long cells = ctx->solve_size;
+    long len   = 0;
+    long entry, cell, next;
+    int  x, y, n;
+
+    memset(ctx->solve_parent, 0xff, cells * sizeof(*ctx->solve_parent));
+    ctx->solve_parent[start] = start;
+    ctx->solve_cost  [start] = 0;
+    heap_push(ctx->solve_queue, &len, estimate(start) * cells + start);
+    while (len > 0) {
+        entry = heap_pop(ctx->solve_queue, &len);
+        cell  = entry % cells;
+        if (cell == goal)
+            break;
+        if (entry / cells != estimate(cell))        // since found a cheaper way
+            continue;
+        x = solve_x(cell);
+        y = solve_y(cell);
+        for (n = 0; n < 4; n++) {
+            if (passage(ctx, x, y, n) && (ctx->solve_parent[next = cell_num(x + solve_tbl[n].x, y + solve_tbl[n].y)] < 0 ||
+                                     ctx->solve_cost[next] > ctx->solve_cost[cell] + 1)) {
+                ctx->solve_parent[next] = cell;
+                ctx->solve_cost  [next] = ctx->solve_cost[cell] + 1;
+                heap_push(ctx->solve_queue, &len, estimate(next) * cells + next);
+            }
+        }
+    }
+    ctx->solve_parent[start] = -1;
+    return (parent_path(ctx));
+}
+
+// Turns solve_dfs() would count wandering into the dead ends off the way through at x, y in the direction of
+// solve_tbl[n] and backing out of them again.  Setting off again from a fork always counts a turn, making up
+// for the one counted backing out of the last dead end, so what's left are the forks, each counting a turn
+// (or not) going into its first branch and taking one back (or not) backing out of its last.
+static int side_turns(struct maze_ctx *ctx, int x, int y, int n)
+{
+    long *stack = ctx->solve_queue;                 // cell * 4 + the direction it was entered in
+    long  top   = 0;
+    long  cell;
+    int   turns = 0;
+    int   in, first, last;
+
+    stack[top++] = cell_num(x + solve_tbl[n].x, y + solve_tbl[n].y) * 4 + n;
+    while (top > 0) {
+        cell  = stack[--top];
+        in    = cell & 3;
+        cell /= 4;
+        x     = solve_x(cell);
+        y     = solve_y(cell);
+        first = last = -1;
+        for (n = 0; n < 4; n++) {
+            if (n != (in ^ 1) && passage(ctx, x, y, n)) {
+                if (first < 0) first = n;
+                last = n;
+                stack[top++] = cell_num(x + solve_tbl[n].x, y + solve_tbl[n].y) * 4 + n;
+            }
+        }
+        if (first != last)
+            turns += (in != first) - (in != last);
+    }
+    return (turns);
+}
+
+// Marks the way through the maze found by one of the other solvers, and works out the path_len and turn_cnt
+// solve_dfs() would have ended up with: a turn for each cell on the way through where the first way solve_dfs()
+// would have tried isn't straight on, plus what its detours into the dead ends before the way on added up to.
+static void mark_solution(struct maze_ctx *ctx, int len, int *x, int *y)
+{
+    int last_dir = 0;
+    int i, n, way, first;
+
+    mark_cell(ctx, ctx->beg_x - 1, ctx->beg_y, SOLVED);
+    for (i = 0; i < len; i++) {
+        *x = solve_x(ctx->solve_path[i]);
+        *y = solve_y(ctx->solve_path[i]);
+        mark_cell(ctx, *x, *y, SOLVED);
+        way = 1;                                    // the way on, out the bottom opening from the last cell
+        if (i < len - 1)
+            for (way = 0; ctx->solve_path[i + 1] != cell_num(*x + solve_tbl[way].x, *y + solve_tbl[way].y); way++)
+                ;
+        for (n = 0, first = way; n < way; n++) {    // dead ends solve_dfs() would have tried first, not counting the way back
+            if (passage(ctx, *x, *y, n) && (i == 0 || ctx->solve_path[i - 1] != cell_num(*x + solve_tbl[n].x, *y + solve_tbl[n].y))) {
+                first     = min(first, n);
+                ctx->turn_cnt += side_turns(ctx, *x, *y, n);
+            }
+        }
+        if (last_dir != solve_tbl[first].heading)
+            ctx->turn_cnt++;
+        n = way;
+        mark_cell(ctx, *x + solve_tbl[n].x/2, *y + solve_tbl[n].y/2, SOLVED);
+        last_dir = solve_tbl[n].heading;
+        ctx->path_len++;
+    }
+    *x += 2;
+    mark_cell(ctx, ctx->end_x + 1, ctx->end_y, SOLVED);
+}
+
+static struct solver_type {
+    const char *name;
+    int (*path)(struct maze_ctx *); // finds the way through into solve_path[], returning its length
+} solver_tbl[] = {
+    { "dfs"    , NULL               },
+    { "bfs"    , solve_path_bfs     },
+    { "deadend", solve_path_deadend },
+    { "astar"  , solve_path_astar   }
+};
+
+#define num_solvers         (int)(sizeof(solver_tbl)/sizeof(solver_tbl[0]))
+
+static void solve_engine(struct maze_ctx *ctx, int *x, int *y)
+{
+    allocate_solve(ctx);
+    mark_solution(ctx, solver_tbl[ctx->solver].path(ctx), x, y);
+}
+
+static double then(struct timespec *t)                     // seconds since t, which is moved up to now
+{
+    struct timespec now;
+    double secs;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    secs = (now.tv_sec - t->tv_sec) + (now.tv_nsec - t->tv_nsec) / 1e9;
+    *t   = now;
+    return (secs);
+}
+
+static void solve_maze(struct maze_ctx *ctx, int *x, int *y)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    ctx->path_len = 0;
+    ctx->turn_cnt = 0;
+
+    if (ctx->solver == DFS_SOLVER) solve_dfs(ctx, x, y);
+    else                           solve_engine(ctx, x, y);
+    ctx->solves++;
+    ctx->phase_secs[SOLVE_PHASE] = then(&t);
+}
+
+static void create_openings(struct maze_ctx *ctx, int *x, int *y)
+{
+    ctx->beg_y = *x;
+    ctx->end_y = *y;
+
+    set_maze(ctx->beg_x - 1, ctx->beg_y, PATH);
+    set_maze(ctx->end_x + 1, ctx->end_y, PATH);
+
+    *x = ctx->beg_x;
+    *y = ctx->beg_y;
+}
+
+static int trial_dir(struct maze_ctx *ctx, grid_t trial, int x, int y, int val)
+{
+    int n;
+
+    for (n = 0; n < 4; n++) {
+        if (get_grid(ctx, trial, x + solve_tbl[n].x/2, y + solve_tbl[n].y/2) == val &&
+            get_grid(ctx, trial, x + solve_tbl[n].x  , y + solve_tbl[n].y  ) == val)
+            return (n);
+    }
+    return (-1);
+}
+
+// Replays solve_maze() from the top opening at start without any bottom opening, until the whole
+// maze has been walked.  The moment the real solver would have stepped out through the bottom opening
+// at a given finish is known (it looks up before it looks down, so either on first arriving at the
+// finish with no unexplored path above it, or on backing up into the finish from the path above it),
+// so path_len and turn_cnt for every finish are recorded in lens[] and turns[] as the walk goes by.
+static void survey_openings(struct maze_ctx *ctx, grid_t trial, int start, int lens[], int turns[])
+{
+    const struct dir_tbl_type *dir;
+    int x = ctx->beg_x;
+    int y = start;
+    int len  = 0;
+    int turn = 0;
+    int last_dir;
+    int n;
+
+    reset_trial(ctx, trial);
+    for (n = 0; n < ctx->width; n++)
+        lens[n] = -1;
+
+    do {
+        last_dir = 0;                                                       // follow_path()
+        set_grid(ctx, trial, x, y, SOLVED);
+        while (1) {
+            if (x == ctx->end_x && lens[y/2 - 1] < 0 && trial_dir(ctx, trial, x, y, PATH) != 0) {
+                lens [y/2 - 1] = len  + 1;
+                turns[y/2 - 1] = turn + (last_dir != RIGHT);
+            }
+            if ((n = trial_dir(ctx, trial, x, y, PATH)) < 0)
+                break;
+            dir = &solve_tbl[n];
+            set_grid(ctx, trial, x +  dir->x/2, y +  dir->y/2, SOLVED);
+            set_grid(ctx, trial, x += dir->x  , y += dir->y  , SOLVED);
+            len++;
+            if (last_dir != dir->heading) {
+                last_dir  = dir->heading;
+                turn++;
+            }
+        }
+        last_dir = 0;                                                       // back_track_path()
+        set_grid(ctx, trial, x, y, TRIED);
+        while (trial_dir(ctx, trial, x, y, PATH) < 0 && (n = trial_dir(ctx, trial, x, y, SOLVED)) >= 0) {
+            dir = &solve_tbl[n];
+            set_grid(ctx, trial, x +  dir->x/2, y +  dir->y/2, TRIED);
+            set_grid(ctx, trial, x += dir->x  , y += dir->y  , TRIED);
+            len--;
+            if (last_dir != dir->heading) {
+                last_dir  = dir->heading;
+                turn--;
+            }
+            if (x == ctx->end_x && lens[y/2 - 1] < 0) {
+                lens [y/2 - 1] = len  + 1;
+                turns[y/2 - 1] = turn + 1;
+            }
+        }
+    } while (trial_dir(ctx, trial, x, y, PATH) >= 0);
+}
+
+// Surveys the top opening at 2*(i + 1) and keeps the best bottom opening for it in survey_tbl[i]
+static void survey_start(struct maze_ctx *ctx, grid_t trial, int lens[], int turns[], int i)
+{
+    struct survey_type *best = &ctx->survey_tbl[i];
+    int start  = 2*(i + 1);
+    int finish;
+    int j;
+
+    best->finish   = 0;
+    best->path_len = 0;
+    best->turn_cnt = 0;
+    best->solves   = 0;
+
+    if (maze(ctx->beg_x, start - 1) != WALL && maze(ctx->beg_x, start + 1) != WALL)
+        return;
+    survey_openings(ctx, trial, start, lens, turns);
+    for (j = 0; j < ctx->width; ++j) {
+        finish = 2*(j + 1);
+        if (maze(ctx->end_x, finish - 1) != WALL && maze(ctx->end_x, finish + 1) != WALL) continue;
+        if (lens[j] >  best->path_len ||
+           (lens[j] == best->path_len &&
+           turns[j] >  best->turn_cnt)) {
+            best->finish   = finish  ;
+            best->turn_cnt = turns[j];
+            best->path_len = lens [j];
+        }
+        best->solves++;
+    }
+}
+
+// Each search thread surveys top openings from a private copy of the maze, taking the next
+// unsurveyed one as it finishes (rows vary a lot in cost since skipped openings cost nothing)
+static void *survey_thread(void *arg)
+{
+    struct maze_ctx *ctx = arg;
+    grid_t trial = new_trial(ctx);
+    int   *lens  = malloc(ctx->width * sizeof(int));
+    int   *turns = malloc(ctx->width * sizeof(int));
+    int i;
+
+    if (!trial || !lens || !turns) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    while ((i = __sync_fetch_and_add(&ctx->next_start, 1)) < ctx->width)
+        survey_start(ctx, trial, lens, turns, i);
+
+    free(turns);
+    free(lens);
+    free_trial(ctx, trial);
+    return (NULL);
+}
+
+static void search_best_openings(struct maze_ctx *ctx, int *x, int *y)
+{
+    pthread_t thread[MAX_THREADS];
+    int best_path_len = 0;
+    int best_turn_cnt = 0;
+    int best_start    = 2;
+    int best_finish   = 2;
+    int n = 1;
+    int i;
+
+    if (!(ctx->survey_tbl = realloc(ctx->survey_tbl, ctx->width * sizeof(*ctx->survey_tbl)))) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    ctx->next_start = 0;
+    while (n < ctx->threads && pthread_create(&thread[n], NULL, survey_thread, ctx) == 0)
+        n++;
+    survey_thread(ctx);
+    while (--n > 0)
+        pthread_join(thread[n], NULL);
+
+    ctx->path_bound = 0;
+    for (i = 0; i < ctx->width; ++i) {              // reduce in the same order with the same tie-break so the
+        if (ctx->survey_tbl[i].path_len >  best_path_len || // openings chosen do not depend on the number of threads
+           (ctx->survey_tbl[i].path_len == best_path_len &&
+            ctx->survey_tbl[i].turn_cnt >  best_turn_cnt)) {
+            best_start      = 2*(i + 1);
+            best_finish     = ctx->survey_tbl[i].finish  ;
+            best_turn_cnt   = ctx->survey_tbl[i].turn_cnt;
+            best_path_len   = ctx->survey_tbl[i].path_len;
+            ctx->max_path_length = ctx->survey_tbl[i].path_len;
+        }
+        ctx->num_solves += ctx->survey_tbl[i].solves;
+    }
+    *x = best_start;
+    *y = best_finish;
+    create_openings(ctx, x, y);
+}
+
+// An open wall between two cells, with all the walls joining it at either end open too
+static int mid_wall_opening(struct maze_ctx *ctx, int x, int y)
+{
+    if (is_odd(x))                                  // between the cells above & below
+        return ((ctx->cell_mask[mask_cell(x - 1, y)] & (OPEN_WALL(1) | OPEN_WALL(2) | OPEN_WALL(3))) == (OPEN_WALL(1) | OPEN_WALL(2) | OPEN_WALL(3)) &&
+                (ctx->cell_mask[mask_cell(x + 1, y)] & (OPEN_WALL(2) | OPEN_WALL(3))) == (OPEN_WALL(2) | OPEN_WALL(3)));
+    else                                            // between the cells left & right
+        return ((ctx->cell_mask[mask_cell(x, y - 1)] & (OPEN_WALL(0) | OPEN_WALL(1) | OPEN_WALL(3))) == (OPEN_WALL(0) | OPEN_WALL(1) | OPEN_WALL(3)) &&
+                (ctx->cell_mask[mask_cell(x, y + 1)] & (OPEN_WALL(0) | OPEN_WALL(1))) == (OPEN_WALL(0) | OPEN_WALL(1)));
+}
+
+struct wall_queue {                                 // wall locations to look at again, as x*max_y + y, smallest first
+    long *heap;
+    long  len;
+    long  size;
+};
+
+// Queues the wall at x, y and those diagonally next to it, all of whose mid_wall_opening() it changing may change:
+// in this sweep (q[0]) if the sweep hasn't got past them yet, otherwise in the next (q[1])
+static void queue_mid_walls(struct maze_ctx *ctx, struct wall_queue q[2], long pos, int x, int y)
+{
+    int k;
+
+    for (k = 0; k < 5; k++) {
+        int  wx = x + (k < 4 ? 2*(k >> 1) - 1 : 0);
+        int  wy = y + (k < 4 ? 2*(k &  1) - 1 : 0);
+        long at = (long)wx * ctx->max_y + wy;
+        struct wall_queue *w = &q[at <= pos];
+
+        if (wx < 1 || wx >= 2 * (ctx->height + 1) || wy < 1 || wy >= 2 * (ctx->width + 1))
+            continue;
+        if (w->len == w->size) {
+            w->size = max(2*w->size, 1024L);
+            if (!(w->heap = realloc(w->heap, w->size * sizeof(long)))) {
+                fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+                exit(1);
+            }
+        }
+        heap_push(w->heap, &w->len, at);
+    }
+}
+
+static int push_mid_wall(struct maze_ctx *ctx, struct wall_queue q[2], long pos, int i, int j)
+{
+    int x = is_odd(i) ? i : i + 2;
+    int y = is_odd(i) ? j + 2 : j;
+
+    if (!mid_wall_opening(ctx, i, j))
+        return (0);
+    mark_cell(ctx, i, j, WALL);
+    mark_cell(ctx, x, y, PATH);                     // push right, or down
+    ++ctx->num_wall_push;
+    queue_mid_walls(ctx, q, pos, i, j);
+    queue_mid_walls(ctx, q, pos, x, y);
+    return (1);
+}
+
+// Pushes mid wall openings right (or down) until there are none, just as sweeping the whole maze again and again
+// until a sweep found none would, but sweeping it only once: after that, each sweep looks at just the walls a push
+// in the sweep before might have changed, in the same order, along with any the pushes in it change further on.
+// Returns the number of openings moved.
+static int push_mid_wall_openings(struct maze_ctx *ctx)
+{
+    struct wall_queue q[2] = {}, t;
+    long pos, last;
+    int  moves = 0;
+    int  i, j;
+
+    for (i = 1; i < 2 * (ctx->height + 1); ++i) {
+        for (j = (i & 1) + 1; j < 2 * (ctx->width + 1); j += 2)
+            moves += push_mid_wall(ctx, q, (long)i * ctx->max_y + j, i, j);
+    }
+    q[0].len = 0;                                   // the sweep got to those anyway
+
+    while (q[1].len) {
+        t = q[0], q[0] = q[1], q[1] = t;
+        for (last = -1; q[0].len; last = pos) {
+            if ((pos = heap_pop(q[0].heap, &q[0].len)) != last)
+                moves += push_mid_wall(ctx, q, pos, pos / ctx->max_y, pos % ctx->max_y);
+        }
+    }
+    free(q[0].heap);
+    free(q[1].heap);
+    return (moves);
+}
+
+static void carve_paths(struct maze_ctx *ctx, int *x, int *y)    // from x, y until every cell is on one
+{
+    ctx->frontier_on = 1;
+    do {
+        ctx->num_paths++;
+        carve_path(ctx, x, y);
+        if (spec_best && *(volatile int *)spec_best < spec_try)
+            _exit(0);                               // another worker already has a lower seed that works
+    } while (find_path_start(ctx, x, y) != 0);
+    ctx->frontier_on = 0;
+}
+
+static void clear_counts(struct maze_ctx *ctx)             // of what carving took
+{
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->max_checks = 0;
+    ctx->maze_len   = 0;
+    ctx->num_paths  = 0;
+    ctx->num_check_exceeded = 0;
+}
+
+static void add_stats(struct stats_type *to, const struct stats_type *from)
+{
+    int p, d;
+
+    to->mazes           += from->mazes;
+    to->look_aheads     += from->look_aheads;
+    to->depth_drops     += from->depth_drops;
+    to->orphans         += from->orphans;
+    to->checks_exceeded += from->checks_exceeded;
+    to->path_starts     += from->path_starts;
+    to->start_words     += from->start_words;
+    to->max_start_words  = max(to->max_start_words, from->max_start_words);
+    to->diameter         = max(to->diameter, from->diameter);
+    to->longest_through  = max(to->longest_through, from->longest_through);
+    to->straights       += from->straights;
+    to->corners         += from->corners;
+    for (d = 0; d <= MAX_DEPTH; d++)
+        to->depth_hist[d] += from->depth_hist[d];
+    for (d = 0; d < 5; d++)
+        to->ways_hist[d] += from->ways_hist[d];
+    for (d = 0; d < TURN_BUCKETS; d++)
+        to->turn_hist[d] += from->turn_hist[d];
+    for (p = 0; p < NUM_PHASES; p++)
+        to->phase_secs[p] += from->phase_secs[p];
+}
+
+struct tiling_type {                // a maze being carved a tile at a time, by several threads at once
+    struct maze_ctx *ctx;
+    int  rows;                      // tiles down & across
+    int  cols;
+    int  next;                      // next tile to be carved (shared by all tile threads)
+    int *seeds;                     // each tile's own, so the maze doesn't depend on which thread carves what
+    pthread_mutex_t lock;           // held while copying a tile into the maze
+};
+
+// Each tile thread carves tiles as mazes of their own, with the same look ahead and orphan rules,
+// copying the paths of each into its place in the maze
+static void *tile_thread(void *arg)
+{
+    struct tiling_type *tiling = arg;
+    struct maze_ctx    *ctx    = tiling->ctx;
+    struct maze_ctx    *tile   = new_ctx();
+    int i, x, y;
+
+    tile->depth        = ctx->depth;
+    tile->limit_checks = ctx->limit_checks;
+    tile->rng          = ctx->rng;
+    tile->unseen       = 1;                         // (only the maze it's copied into is drawn)
+    while ((i = __sync_fetch_and_add(&tiling->next, 1)) < tiling->rows * tiling->cols) {
+        int r0 = i / tiling->cols * ctx->tile;      // cells above & left of the tile
+        int c0 = i % tiling->cols * ctx->tile;
+
+        tile->height = min(ctx->tile, ctx->height - r0);
+        tile->width  = min(ctx->tile, ctx->width  - c0);
+        seed_rand(tile, tiling->seeds[i]);
+        clear_counts(tile);
+        initialize_maze(tile, &x, &y);
+        carve_paths(tile, &x, &y);
+
+        pthread_mutex_lock(&tiling->lock);          // (compact mazes share plane words across tile edges)
+        for (x = 2; x <= 2*tile->height; x++)
+            for (y = 2; y <= 2*tile->width; y++)
+                if (get_grid(tile, tile->maze_cells, x, y) == PATH)
+                    set_maze(2*r0 + x, 2*c0 + y, PATH);
+        ctx->num_paths         += tile->num_paths;
+        ctx->maze_len          += tile->maze_len;
+        ctx->num_check_exceeded += tile->num_check_exceeded;
+        ctx->max_checks         = max(ctx->max_checks, tile->max_checks);
+        add_stats(&ctx->stats, &tile->stats);
+        pthread_mutex_unlock(&tiling->lock);
+    }
+    free_ctx(tile);
+    return (NULL);
+}
+
+// Carves the maze in tiles, then joins them with one opening in the wall between some pairs of tiles next to each
+// other, just enough to join them all without making a loop (a random spanning tree of the tiles) so it's still a
+// perfect maze.  Joining every pair would make loops whenever there are tiles both down and across.
+static void carve_tiles(struct maze_ctx *ctx)
+{
+    struct tiling_type tiling = { .ctx = ctx };
+    pthread_t thread[MAX_THREADS];
+    int *set;                                       // union find of the tiles joined so far
+    int *edge;                                      // walls between tiles, (tile << 1) | (0 to the right, 1 below)
+    int num_tiles, num_edges = 0;
+    int i, j, n = 1;
+
+    tiling.rows = (ctx->height + ctx->tile - 1) / ctx->tile;
+    tiling.cols = (ctx->width  + ctx->tile - 1) / ctx->tile;
+    num_tiles   = tiling.rows * tiling.cols;
+    tiling.seeds = malloc(num_tiles * sizeof(int));
+    set          = malloc(num_tiles * sizeof(int));
+    edge         = malloc(2 * num_tiles * sizeof(int));
+    if (!tiling.seeds || !set || !edge) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    for (i = 0; i < num_tiles; i++) {
+        tiling.seeds[i] = rng_step(ctx);
+        set[i] = i;
+        if (i % tiling.cols < tiling.cols - 1) edge[num_edges++] = i << 1;
+        if (i / tiling.cols < tiling.rows - 1) edge[num_edges++] = i << 1 | 1;
+    }
+    pthread_mutex_init(&tiling.lock, NULL);
+    while (n < ctx->threads && pthread_create(&thread[n], NULL, tile_thread, &tiling) == 0)
+        n++;
+    tile_thread(&tiling);
+    while (--n > 0)
+        pthread_join(thread[n], NULL);
+    pthread_mutex_destroy(&tiling.lock);
+
+    for (i = num_edges; i > 0; i--) {               // Kruskal, taking the walls in a random order
+        int e = edge[j = rng_step(ctx) % i];
+        int a = e >> 1;
+        int b = a + ((e & 1) ? tiling.cols : 1);
+        int r0 = a / tiling.cols * ctx->tile;
+        int c0 = a % tiling.cols * ctx->tile;
+
+        edge[j] = edge[i - 1];
+        while (set[a] != a) a = set[a] = set[set[a]];
+        while (set[b] != b) b = set[b] = set[set[b]];
+        if (a == b)
+            continue;
+        set[a] = b;
+        if (e & 1)                                  // somewhere along the bottom of the tile
+            set_maze(2*(r0 + ctx->tile) + 1, 2*(c0 + rng_step(ctx) % min(ctx->tile, ctx->width  - c0)) + 2, PATH);
+        else                                        // or its right side
+            set_maze(2*(r0 + rng_step(ctx) % min(ctx->tile, ctx->height - r0)) + 2, 2*(c0 + ctx->tile) + 1, PATH);
+        ctx->maze_len++;
+    }
+    for (i = 0; i < ctx->max_x; i += 2)             // the masks never saw any of it
+        for (j = 0; j < ctx->max_y; j += 2)
+            set_mask(ctx, i, j);
+    resync_render();                                // nor did the renderer
+
+    free(edge);
+    free(set);
+    free(tiling.seeds);
+}
+
+#define NO_ROW              (INT32_MIN/2)                   // no way down to the row, even after adding a few steps
+
+#define ways_out(x, y)      __builtin_popcount(ctx->cell_mask[mask_cell(x, y)] & 15)
+
+// Puts the cell at x, y, reached going down the tree in direction n (-1 for the root), on the tree stack at sp,
+// counting it and, if it ends one, the passage from the last dead end or fork
+static void tree_cell(struct maze_ctx *ctx, long sp, int x, int y, int n)
+{
+    struct stats_type *st = &ctx->stats;
+    struct tree_type  *t;
+    int m = ctx->cell_mask[mask_cell(x, y)] & 15;
+
+    if (sp == ctx->tree_size) {
+        ctx->tree_size = max(2*ctx->tree_size, 1024L);
+        if (!(ctx->tree_stack = realloc(ctx->tree_stack, ctx->tree_size * sizeof(*ctx->tree_stack)))) {
+            fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+            exit(1);
+        }
+    }
+    t = &ctx->tree_stack[sp];
+    t->x      = x;
+    t->y      = y;
+    t->back   = n < 0 ? -1 : n ^ 1;
+    t->dir    = 0;
+    t->turns  = 0;
+    t->down   = 0;
+    t->top    = x == ctx->beg_x ? 0 : NO_ROW;
+    t->bottom = x == ctx->end_x ? 0 : NO_ROW;
+
+    st->ways_hist[ways_out(x, y)]++;
+    if (ways_out(x, y) == 2) {
+        if (m == (OPEN_WALL(0) | OPEN_WALL(1)) || m == (OPEN_WALL(2) | OPEN_WALL(3))) st->straights++;
+        else                                                                          st->corners++;
+    }
+    if (sp > 0 && ways_out(t[-1].x, t[-1].y) == 2)  // still on the passage its parent is on
+        t->turns = t[-1].turns + (n != (t[-1].back ^ 1));
+    if (sp > 0 && ways_out(x, y) != 2)
+        st->turn_hist[min(t->turns, TURN_BUCKETS - 1)]++;
+}
+
+// Goes over the finished maze once, as the tree it is, working out what makes it hard or easy: the longest way
+// between any two cells, and between the top & bottom rows (the longest way through any openings could give, so
+// just what search_best_openings() finds), cells by ways out, and passages by turns.  It walks down the tree
+// depth first from a dead end (so no passage is split in two), working out the longest ways down from each cell
+// as it backs up.
+static void analyze_tree(struct maze_ctx *ctx)
+{
+    struct tree_type *t, *p;
+    long sp = 1;
+    int  x = ctx->beg_x, y = 2, n;
+    int  diameter = 0;
+    int  through  = ctx->height == 1 ? 0 : NO_ROW;  // a cell in both rows is a way through on its own
+
+    while (ways_out(x, y) > 1) {                    // there's always a dead end, or just the one cell
+        if ((y += 2) > 2*ctx->width) {
+            y  = 2;
+            x += 2;
+        }
+    }
+    tree_cell(ctx, 0, x, y, -1);
+    while (sp > 0) {
+        t = &ctx->tree_stack[sp - 1];
+        while (t->dir < 4 && (t->dir == t->back || !(ctx->cell_mask[mask_cell(t->x, t->y)] & OPEN_WALL(t->dir))))
+            t->dir++;
+        if (t->dir < 4) {                           // on down the next way
+            n = t->dir++;
+            tree_cell(ctx, sp++, t->x + solve_tbl[n].x, t->y + solve_tbl[n].y, n);
+        } else if (--sp > 0) {                      // back up, adding the ways down from here to its parent's
+            p = t - 1;
+            diameter  = max(diameter, p->down + t->down + 1);
+            through   = max(through , max(p->top + t->bottom, p->bottom + t->top) + 1);
+            p->down   = max(p->down  , t->down   + 1);
+            p->top    = max(p->top   , t->top    + 1);
+            p->bottom = max(p->bottom, t->bottom + 1);
+        }
+    }
+    ctx->stats.diameter        = diameter + 1;      // in cells, like path lengths
+    ctx->stats.longest_through = through  + 1;
+}
+
+static void carve_maze(struct maze_ctx *ctx, int *x, int *y, struct timespec *t)
+{
+    clock_gettime(CLOCK_MONOTONIC, t);
+    clear_counts(ctx);
+    initialize_maze(ctx, x, y);
+    ctx->phase_secs[INIT_PHASE] = then(t);
+    if (fps)
+        start_render(ctx);
+    if (ctx->tile > 0 && (ctx->tile < ctx->height || ctx->tile < ctx->width))
+        carve_tiles(ctx);
+    else
+        carve_paths(ctx, x, y);
+    ctx->phase_secs[CARVE_PHASE] = then(t);
+
+    push_mid_wall_openings(ctx);
+    ctx->phase_secs[PUSH_PHASE] = then(t);
+
+    analyze_tree(ctx);
+    ctx->phase_secs[ANALYZE_PHASE] = then(t);
+}
+
+#ifndef LIBMAZE
+// Makes a maze with the best openings, unless no openings could make a way through of at least min_len
+// cells, when it doesn't search for them.  max_path_length is then longest_through, only an upper bound
+// on what they would have given, as the search skips top & bottom cells with both side walls open; it
+// is still below min_len, so the maze is rightly rejected, but it's flagged in path_bound.  Returns
+// whether it has openings.
+static int create_maze(struct maze_ctx *ctx, int *x, int *y, int min_len)
+{
+    struct timespec t;
+
+    carve_maze(ctx, x, y, &t);
+    stop_render();  // don't draw updates while solving for best openings
+    if (ctx->stats.longest_through < min_len) {
+        ctx->max_path_length = ctx->stats.longest_through;
+        ctx->path_bound      = 1;
+        ctx->phase_secs[OPENINGS_PHASE] = ctx->phase_secs[SOLVE_PHASE] = 0;
+        return (0);
+    }
+    search_best_openings(ctx, x, y);
+    ctx->phase_secs[OPENINGS_PHASE] = then(&t);
+    return (1);
+}
+
+// Makes mazes from seeds seed, seed + 1, ... in jobs worker processes at once (each with its own copy of
+// the maze) until one has a path of at least min_len, returning how many seeds past seed the lowest such
+// seed is.  Workers give up on any seed above the lowest found so far, and since each tries its own seeds
+// in order, the seed returned is the one trying seeds one at a time would have stopped at.
+static int speculate(struct maze_ctx *ctx, int min_len)
+{
+    pid_t pid[MAX_JOBS];
+    struct timespec t;
+    int x, y;
+    int best;
+    int j;
+
+    if ((spec_best = mmap(NULL, sizeof(*spec_best), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    *spec_best = INT32_MAX;
+    for (j = 0; j < jobs; j++) {
+        if ((pid[j] = fork()) < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid[j] == 0) {
+            fps = 0;                                // workers never draw, and exit without flushing the parent's output
+            for (spec_try = j; spec_try < *(volatile int *)spec_best; spec_try += jobs) {
+                seed_rand(ctx, ctx->seed + spec_try);
+                carve_maze(ctx, &x, &y, &t);        // how long the way through can be is known without any openings
+                if (ctx->stats.longest_through >= min_len) {
+                    while ((best = *(volatile int *)spec_best) > spec_try &&
+                           !__sync_bool_compare_and_swap(spec_best, best, spec_try))
+                        ;
+                    break;
+                }
+            }
+            _exit(0);
+        }
+    }
+    for (j = 0; j < jobs; j++)
+        waitpid(pid[j], NULL, 0);
+
+    best = *spec_best;
+    munmap(spec_best, sizeof(*spec_best));
+    spec_best = NULL;
+    return (best);
+}
+#endif
+
+// FNV-1a of whether each location is a wall, row by row.  It's the same however the maze is kept, solved or not,
+// and maze.go and maze_view hash their mazes the same way, so the same maze always has the same hash.
+static uint64_t walls_hash(struct maze_ctx *ctx)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    int x, y;
+
+    for (x = 0; x < ctx->max_x; x++)
+        for (y = 0; y < ctx->max_y; y++)
+            hash = (hash ^ (maze(x, y) == WALL)) * 1099511628211ULL;
+    return (hash);
+}
+
+#ifndef LIBMAZE
+// Writes one line of JSON with the stats for the last maze (or for the run so far, when st is &run_stats)
+static void write_stats(struct maze_ctx *ctx, FILE *fp, struct stats_type *st)
+{
+    int p, d;
+
+    if (st == &ctx->stats)
+        fprintf(fp, "{ \"maze\": %ld, \"seed\": %d, \"height\": %d, \"width\": %d, \"depth\": %d, \"maze_len\": %d, \"num_paths\": %d, \"max_path_length\": %d, "
+                    "\"max_path_length_bound\": %s, \"num_wall_push\": %d, \"walls_hash\": \"%016llx\", ",
+                    run_stats.mazes, ctx->seed, ctx->height, ctx->width, ctx->depth, ctx->maze_len, ctx->num_paths, ctx->max_path_length,
+                    ctx->path_bound ? "true" : "false", ctx->num_wall_push, (unsigned long long)walls_hash(ctx));
+    else
+        fprintf(fp, "{ \"run\": %ld, \"height\": %d, \"width\": %d, \"depth\": %d, ", st->mazes, ctx->height, ctx->width, ctx->depth);
+
+    fprintf(fp, "\"look_aheads\": %ld, \"depth_drops\": %ld, \"orphans\": %ld, \"checks_exceeded\": %ld, "
+                "\"path_starts\": %ld, \"start_words\": %ld, \"start_words_per_call\": %.2f, \"max_start_words\": %ld, \"depth_hist\": [",
+                st->look_aheads, st->depth_drops, st->orphans, st->checks_exceeded,
+                st->path_starts, st->start_words, (double)st->start_words / max(st->path_starts, 1L), st->max_start_words);
+    for (d = 0; d <= ctx->depth; d++)
+        fprintf(fp, "%s%ld", d ? ", " : "", st->depth_hist[d]);
+    fprintf(fp, "], \"diameter\": %ld, \"longest_through\": %ld, \"dead_ends\": %ld, \"straights\": %ld, \"corners\": %ld, \"ways_hist\": [",
+                st->diameter, st->longest_through, st->ways_hist[1], st->straights, st->corners);
+    for (d = 0; d < 5; d++)
+        fprintf(fp, "%s%ld", d ? ", " : "", st->ways_hist[d]);
+    fprintf(fp, "], \"turn_hist\": [");
+    for (d = 0; d < TURN_BUCKETS; d++)
+        fprintf(fp, "%s%ld", d ? ", " : "", st->turn_hist[d]);
+    fprintf(fp, "], \"phase_ms\": { ");
+    for (p = 0; p < NUM_PHASES; p++)
+        fprintf(fp, "%s\"%s\": %.3f", p ? ", " : "", phase_names[p], 1e3 * st->phase_secs[p]);
+    fprintf(fp, " } }\n");
+}
+
+// Records the stats for the maze just made, adding them to the run's
+static void maze_stats(struct maze_ctx *ctx)
+{
+    int p;
+
+    for (p = 0; p < NUM_PHASES; p++)
+        ctx->stats.phase_secs[p] = ctx->phase_secs[p];
+    ctx->stats.mazes = 1;
+    add_stats(&run_stats, &ctx->stats);
+
+    if (stats_on)
+        write_stats(ctx, stderr, &ctx->stats);
+}
+
+static int compare_secs(const void *a, const void *b)
+{
+    return ((*(const double *)a > *(const double *)b) - (*(const double *)a < *(const double *)b));
+}
+
+static double percentile(double *secs, int n, int p)      // nearest rank, of secs sorted
+{
+    int rank = (p * n + 99) / 100;
+
+    return (secs[max(rank, 1) - 1]);
+}
+
+// Times each phase of making runs mazes (seeds seed on) for each benchmark size and depth, or just the
+// height, width or depth given, and writes the mean, median and 99th percentile of each in milliseconds
+static void run_bench(struct maze_ctx *ctx, FILE *fp, int runs, int bench_height, int bench_width, int bench_depth)
+{
+    double *secs = malloc((NUM_PHASES + 1) * runs * sizeof(double));
+    int     first_seed = ctx->seed;
+    int     i, d, r, p;
+    int     x, y;
+    int     rows = 0;
+
+    if (!secs) {
+        fprintf(stderr, "unable to allocate benchmark results\n");
+        exit(1);
+    }
+    if (format == CSV_FORMAT)
+        fprintf(fp, "height,width,depth,threads,solver,phase,runs,mean_ms,p50_ms,p99_ms\n");
+    else
+        fprintf(fp, "{ \"version\": \"%s\", \"runs\": %d, \"seed\": %d, \"results\": [\n", VERSION, runs, first_seed);
+
+    for (i = 0; i < (int)(sizeof(bench_sizes)/sizeof(bench_sizes[0])); i++) {
+        if ((bench_height && i) || (bench_width && i))
+            break;                                  // just the one size
+        ctx->height = bench_height ? bench_height : bench_sizes[i].height;
+        ctx->width  = bench_width  ? bench_width  : bench_sizes[i].width ;
+        for (d = 0; d < (int)(sizeof(bench_depths)/sizeof(bench_depths[0])); d++) {
+            if (bench_depth >= 0 && d)
+                break;
+            ctx->depth = bench_depth >= 0 ? bench_depth : bench_depths[d];
+            for (r = 0; r < runs; r++) {
+                ctx->seed = first_seed + r;
+                seed_rand(ctx, ctx->seed);
+                create_maze(ctx, &x, &y, 0);
+                solve_maze(ctx, &x, &y);
+                for (p = 0; p < NUM_PHASES; p++)
+                    secs[p * runs + r] = ctx->phase_secs[p];
+                secs[NUM_PHASES * runs + r] = 0;
+                for (p = 0; p < NUM_PHASES; p++)
+                    secs[NUM_PHASES * runs + r] += ctx->phase_secs[p];
+            }
+            for (p = 0; p <= NUM_PHASES; p++) {
+                double *v   = secs + p * runs;
+                double  sum = 0;
+
+                qsort(v, runs, sizeof(double), compare_secs);
+                for (r = 0; r < runs; r++)
+                    sum += v[r];
+                if (format == CSV_FORMAT)
+                    fprintf(fp, "%d,%d,%d,%d,%s,%s,%d,%.3f,%.3f,%.3f\n",
+                            ctx->height, ctx->width, ctx->depth, ctx->threads, solver_tbl[ctx->solver].name, p < NUM_PHASES ? phase_names[p] : "total",
+                            runs, 1e3 * sum / runs, 1e3 * percentile(v, runs, 50), 1e3 * percentile(v, runs, 99));
+                else
+                    fprintf(fp, "%s  { \"height\": %d, \"width\": %d, \"depth\": %d, \"threads\": %d, \"solver\": \"%s\", \"phase\": \"%s\", "
+                                "\"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p99_ms\": %.3f }",
+                            rows++ ? ",\n" : "", ctx->height, ctx->width, ctx->depth, ctx->threads, solver_tbl[ctx->solver].name, p < NUM_PHASES ? phase_names[p] : "total",
+                            1e3 * sum / runs, 1e3 * percentile(v, runs, 50), 1e3 * percentile(v, runs, 99));
+                fflush(fp);
+            }
+        }
+    }
+    if (format == JSON_FORMAT)
+        fprintf(fp, "\n] }\n");
+    free(secs);
+}
+
+// Streaming mazes, carved a row at a time the way Eller's algorithm does, so only a row of cells (one set of the
+// cells joined so far for each) is ever kept and each row is written out as soon as it's finished.  To choose the
+// bottom opening, each set also keeps its tree of paths, cut down to the cells of the current row, the top
+// opening's cell and the forks between them, with the number of steps along each branch.  Once the last row
+// has joined every set into one tree, the bottom opening goes under the cell farthest from the top opening.
+struct stream_node {
+    int  parent;                    // -1 at the root (the top opening's cell is always the root of its tree)
+    int  child;                     // first child, the rest through next (and back through prev)
+    int  next;
+    int  prev;
+    int  num_children;
+    int  keep;                      // a cell of the current row (or the top opening's), -1 once free
+    long len;                       // steps to the parent
+};
+
+struct stream_type {
+    struct maze_ctx    *ctx;
+    FILE               *fp;
+    int                *set;        // each column's set, as a union-find forest of columns
+    int                *start;      // the set rooted at a column has the top opening's cell
+    int                *next_start;
+    int                *node;       // each column's cell
+    int                *old_node;   // its cell in the row above, while stepping down
+    int                *first;      // the first column each set carries down
+    int                *last;       // the last column of each set
+    char               *right;      // the wall to the right of each column is open
+    char               *down;       // the wall below each column is open
+    struct stream_node *nodes;
+    int                 free_node;  // through parent
+    int                 top;        // the top opening's cell
+    char               *buf;        // rows being written out
+    char               *row[3];
+    char               *out;
+    char               *locs;       // the next one
+    uint64_t           *plane_row;
+    long                plane_base; // file offset of the binary maze's walls
+    int                 x;          // next location row to write out
+};
+
+static int stream_find(struct stream_type *ss, int j)
+{
+    while (ss->set[j] != j)
+        j = ss->set[j] = ss->set[ss->set[j]];
+    return (j);
+}
+
+static int new_stream_node(struct stream_type *ss)
+{
+    int                 n = ss->free_node;
+    struct stream_node *p = &ss->nodes[n];
+
+    ss->free_node   = p->parent;
+    p->parent       = -1;
+    p->child        = -1;
+    p->num_children = 0;
+    p->keep         = 1;
+    p->len          = 0;
+    return (n);
+}
+
+static void free_stream_node(struct stream_type *ss, int n)
+{
+    ss->nodes[n].keep   = -1;
+    ss->nodes[n].parent = ss->free_node;
+    ss->free_node       = n;
+}
+
+static void link_stream_node(struct stream_type *ss, int n, int parent, long len)
+{
+    struct stream_node *p = &ss->nodes[n];
+
+    p->parent = parent;
+    p->len    = len;
+    p->prev   = -1;
+    p->next   = ss->nodes[parent].child;
+    if (p->next >= 0)
+        ss->nodes[p->next].prev = n;
+    ss->nodes[parent].child = n;
+    ss->nodes[parent].num_children++;
+}
+
+static void unlink_stream_node(struct stream_type *ss, int n)
+{
+    struct stream_node *p = &ss->nodes[n];
+
+    if (p->prev >= 0) ss->nodes[p->prev].next  = p->next;
+    else              ss->nodes[p->parent].child = p->next;
+    if (p->next >= 0) ss->nodes[p->next].prev  = p->prev;
+    ss->nodes[p->parent].num_children--;
+    p->parent = -1;
+}
+
+static int reroot_stream_node(struct stream_type *ss, int n)     // makes n the root of its tree, returning the old root
+{
+    int  prev = -1, parent;
+    long prev_len = 0, len;
+
+    while (n >= 0) {
+        parent = ss->nodes[n].parent;
+        len    = ss->nodes[n].len;
+        if (parent >= 0)
+            unlink_stream_node(ss, n);
+        if (prev >= 0)
+            link_stream_node(ss, n, prev, prev_len);
+        prev     = n;
+        prev_len = len;
+        n        = parent;
+    }
+    return (prev);
+}
+
+// Drops n if it's no longer needed: a cell that isn't in the current row and isn't a fork, going on up
+// the tree as long as that leaves its parent not needed either
+static void prune_stream_node(struct stream_type *ss, int n)
+{
+    while (n >= 0 && ss->nodes[n].keep == 0 && n != ss->top) {
+        struct stream_node *p = &ss->nodes[n];
+        int parent = p->parent;
+        int child  = p->child;
+
+        if (p->num_children > 1)
+            break;
+        if (p->num_children == 1) {                 // one branch on through it, so it's just a step along it
+            long len = ss->nodes[child].len + p->len;
+
+            unlink_stream_node(ss, child);
+            if (parent >= 0) {
+                unlink_stream_node(ss, n);
+                link_stream_node(ss, child, parent, len);
+            }
+            free_stream_node(ss, n);
+            break;
+        }
+        if (parent >= 0)                            // a dead end
+            unlink_stream_node(ss, n);
+        free_stream_node(ss, n);
+        n = parent;
+    }
+}
+
+// Joins the cell at column j to the one to its right, hanging the tree without the top opening (if either
+// has it) from the other
+static void join_stream_cells(struct stream_type *ss, int j)
+{
+    int a = stream_find(ss, j);
+    int b = stream_find(ss, j + 1);
+    int u = ss->node[j];
+    int v = ss->node[j + 1];
+    int root;
+
+    if (ss->start[b]) {
+        u = ss->node[j + 1];
+        v = ss->node[j];
+    }
+    root = reroot_stream_node(ss, v);
+    link_stream_node(ss, v, u, 1);
+    ss->set[b]    = a;
+    ss->start[a] |= ss->start[b];
+    ss->right[j]  = 1;
+    prune_stream_node(ss, root);                    // now just a step along a branch, if it had two
+}
+
+// Writes location row x of the maze, given as one byte per location: as ascii once the row after it is known
+// too, or into its place in each bit-plane of a binary maze
+static void stream_row(struct stream_type *ss, const char *locs)
+{
+    struct maze_ctx *ctx = ss->ctx;
+    long  stride = plane_cols(ctx->max_y);
+    long  rows   = plane_rows(ctx->max_x);
+    int   x      = ss->x++;
+    int   type, X, Y;
+
+    if (format == BINARY_FORMAT) {
+        for (type = ((x + GUARD) & 1) << 1; type < 2 + ((x + GUARD) & 1); type++) {   // cells & right walls, or down walls
+            memset(ss->plane_row, 0, stride/8);
+            X = (x + GUARD) >> 1;
+            for (Y = 0; locs && Y < stride; Y++) {
+                int y = 2*Y + (type & 1) - GUARD;
+
+                if (y >= 0 && y < ctx->max_y && locs[y] == WALL)
+                    ss->plane_row[Y >> 6] |= 1ULL << (Y & 63);
+            }
+            if (fseek(ss->fp, ss->plane_base + (type * rows + X) * stride/8, SEEK_SET) < 0) {
+                perror("fseek");
+                exit(1);
+            }
+            fwrite(ss->plane_row, sizeof(uint64_t), stride/64, ss->fp);
+        }
+        return;
+    }
+    memset(ss->row[x % 3], PATH, ctx->max_y);
+    if (locs)
+        memcpy(ss->row[x % 3], locs, ctx->max_y);
+    if (x >= 2) {
+        output_row(ctx, ss->out, ss->row[(x - 2) % 3], ss->row[(x - 1) % 3], ss->row[x % 3], is_odd(x - 1));
+        ss->out[ctx->max_y - 2] = '\n';
+        fwrite(ss->out, 1, ctx->max_y - 1, ss->fp);
+    }
+}
+
+// The row of cells (and the walls between them) or the row of walls below them, for the current row
+static void stream_cells(struct stream_type *ss, char *locs, int walls_below)
+{
+    struct maze_ctx *ctx = ss->ctx;
+    int j;
+
+    memset(locs, WALL, ctx->max_y);
+    locs[0] = locs[ctx->max_y - 1] = PATH;
+    for (j = 0; j < ctx->width; j++) {
+        if (walls_below)
+            locs[2*j + 2] = ss->down[j] ? PATH : WALL;
+        else {
+            locs[2*j + 2] = PATH;
+            locs[2*j + 3] = ss->right[j] ? PATH : WALL;
+        }
+    }
+}
+
+// Carves and writes out a maze the size of ctx's, from its seed, keeping no more than a few rows of it at once.
+// With no look ahead there's no depth, and nothing but the row being carved is ever known, so the top opening is
+// a random one.  An ascii maze's header can't say where the bottom opening is, so a line after the maze does.
+static void stream_maze(struct maze_ctx *ctx, FILE *fp)
+{
+    struct maze_header hdr = { .magic = MAZE_MAGIC, .version = MAZE_VERSION, .header_size = sizeof(hdr), .byte_order = BYTE_ORDER_MARK };
+    struct stream_type ss = { .ctx = ctx, .fp = fp };
+    int   width = ctx->width;
+    int   num_nodes = 3 * width + 4;              // two a column and the top opening's at most once pruned, and a row on the way
+    int  *tmp;
+    long  dist, max_dist = -1;
+    int   j, k, r, n;
+
+    ctx->max_x = 2*(ctx->height + 1) + 1;
+    ctx->max_y = 2*(width + 1) + 1;
+    ctx->beg_x = 2;
+    ctx->end_x = 2*ctx->height;
+
+    ss.set        = malloc(8 * width * sizeof(int));
+    ss.nodes      = malloc(num_nodes * sizeof(struct stream_node));
+    ss.right      = calloc(2 * width, 1);
+    ss.buf        = calloc(5, ctx->max_y + ROW_PAD);
+    ss.plane_row  = calloc(plane_cols(ctx->max_y)/64, sizeof(uint64_t));
+    if (!ss.set || !ss.nodes || !ss.right || !ss.buf || !ss.plane_row) {
+        fprintf(stderr, "unable to allocate a %d x %d maze\n", ctx->height, ctx->width);
+        exit(1);
+    }
+    ss.start      = ss.set + width;
+    ss.next_start = ss.set + 2 * width;
+    ss.node       = ss.set + 3 * width;
+    ss.old_node   = ss.set + 4 * width;
+    ss.first      = ss.set + 5 * width;
+    ss.last       = ss.set + 6 * width;
+    tmp           = ss.set + 7 * width;         // each column's set in the row above
+    ss.down       = ss.right + width;
+    for (k = 0; k < 3; k++)
+        ss.row[k] = ss.buf + k * (ctx->max_y + ROW_PAD);
+    ss.out        = ss.buf + 3 * (ctx->max_y + ROW_PAD);
+    ss.locs       = ss.buf + 4 * (ctx->max_y + ROW_PAD);
+
+    for (n = 0; n < num_nodes; n++)
+        ss.nodes[n].parent = n + 1 < num_nodes ? n + 1 : -1;
+    for (j = 0; j < width; j++) {
+        ss.set[j]   = j;
+        ss.start[j] = 0;
+        ss.node[j]  = new_stream_node(&ss);
+    }
+    j           = rng_step(ctx) % width;
+    ss.start[j] = 1;
+    ss.top      = ss.node[j];
+    ctx->beg_y  = 2*j + 2;
+
+    if (format == BINARY_FORMAT) {
+        char pad[64] = {};
+
+        ss.plane_base = ftell(fp);
+        fwrite(&hdr, sizeof(hdr), 1, fp);          // filled in once the bottom opening is known
+        fwrite(pad, (64 - sizeof(hdr) % 64) % 64, 1, fp);
+        ss.plane_base += (sizeof(hdr) + 63) / 64 * 64;
+        for (ss.x = -GUARD; ss.x < 0; )
+            stream_row(&ss, NULL);
+    } else
+        fprintf(fp, "seed=%d, height=%d, width=%d, depth=0, beg_y=%d\n", ctx->seed, ctx->height, width, ctx->beg_y);
+
+    stream_row(&ss, NULL);                          // the path around the outside
+    memset(ss.down, 0, width);
+    ss.down[j] = 1;
+    stream_cells(&ss, ss.locs, 1);
+    stream_row(&ss, ss.locs);                        // the top wall, with its opening
+
+    for (r = 0; r < ctx->height; r++) {
+        int last = r == ctx->height - 1;
+
+        memset(ss.right, 0, width);
+        for (j = 0; j + 1 < width; j++)
+            if (stream_find(&ss, j) != stream_find(&ss, j + 1) && (last || (rng_step(ctx) & 1)))
+                join_stream_cells(&ss, j);
+        stream_cells(&ss, ss.locs, 0);
+        stream_row(&ss, ss.locs);
+        if (last)
+            break;
+
+        for (j = 0; j < width; j++) {               // carry each set down at least once
+            tmp[j]      = stream_find(&ss, j);
+            ss.first[j] = -1;
+        }
+        for (j = 0; j < width; j++) {
+            ss.down[j]       = rng_step(ctx) & 1;
+            ss.last[tmp[j]]  = j;
+            if (ss.down[j] && ss.first[tmp[j]] < 0)
+                ss.first[tmp[j]] = j;
+        }
+        for (j = 0; j < width; j++)
+            if (tmp[j] == j && ss.first[j] < 0)
+                ss.down[ss.first[j] = ss.last[j]] = 1;
+
+        for (j = 0; j < width; j++) {               // the row below, carried cells staying in their sets
+            ss.old_node[j] = ss.node[j];
+            ss.nodes[ss.node[j]].keep = 0;
+            ss.node[j] = new_stream_node(&ss);
+            if (ss.down[j]) {
+                link_stream_node(&ss, ss.node[j], ss.old_node[j], 1);
+                ss.set[j] = ss.first[tmp[j]];
+                ss.next_start[j] = ss.start[tmp[j]];
+            } else {
+                ss.set[j] = j;
+                ss.next_start[j] = 0;
+            }
+        }
+        for (j = 0; j < width; j++) {
+            ss.start[j] = ss.next_start[j];
+            prune_stream_node(&ss, ss.old_node[j]);
+        }
+        stream_cells(&ss, ss.locs, 1);
+        stream_row(&ss, ss.locs);
+    }
+
+    for (j = 0; j < width; j++) {                   // one tree now, rooted at the top opening's cell
+        for (dist = 0, n = ss.node[j]; n != ss.top; n = ss.nodes[n].parent)
+            dist += ss.nodes[n].len;
+        if (dist > max_dist) {
+            max_dist   = dist;
+            ctx->end_y = 2*j + 2;
+        }
+    }
+    ctx->max_path_length = (int)min(max_dist + 1, INT32_MAX);
+    memset(ss.down, 0, width);
+    ss.down[(ctx->end_y - 2)/2] = 1;
+    stream_cells(&ss, ss.locs, 1);
+    stream_row(&ss, ss.locs);                        // the bottom wall, with its opening
+    stream_row(&ss, NULL);
+
+    if (format == BINARY_FORMAT) {
+        long rows = plane_rows(ctx->max_x);
+
+        while (ss.x < 2*rows - GUARD)
+            stream_row(&ss, NULL);
+        hdr.height          = ctx->height;
+        hdr.width           = width;
+        hdr.seed            = ctx->seed;
+        hdr.beg_y           = ctx->beg_y;
+        hdr.end_y           = ctx->end_y;
+        hdr.max_path_length = ctx->max_path_length;
+        hdr.maze_len        = (int)min((long)ctx->height * width, INT32_MAX);
+        hdr.plane_stride    = plane_cols(ctx->max_y);
+        hdr.plane_rows      = rows;
+        hdr.size            = (sizeof(hdr) + 63) / 64 * 64 + 3 * hdr.plane_stride/8 * rows;
+        if (fseek(fp, ss.plane_base - (sizeof(hdr) + 63) / 64 * 64, SEEK_SET) < 0) {
+            perror("fseek");
+            exit(1);
+        }
+        fwrite(&hdr, sizeof(hdr), 1, fp);
+        fseek(fp, ss.plane_base + 3 * hdr.plane_stride/8 * rows, SEEK_SET);
+    } else
+        fprintf(fp, "end_y=%d, max_path_length=%ld\n\n", ctx->end_y, max_dist + 1);
+    free(ss.set);
+    free(ss.nodes);
+    free(ss.right);
+    free(ss.buf);
+    free(ss.plane_row);
+}
+
+// Writes the maze just solved in the output format, images with the way through still marked
+static void write_output(struct maze_ctx *ctx, FILE *fp)
+{
+    if (format == PBM_FORMAT || format == PNG_FORMAT)
+        write_image(ctx, fp);
+    restore_maze(ctx);
+    if      (format == BINARY_FORMAT) write_maze(ctx, fp);
+    else if (format == ASCII_FORMAT)  output_maze(ctx, fp);
+}
+
+// Solves and draws or outputs each maze in a binary maze file, returning the number of mazes read
+static int read_mazes(struct maze_ctx *ctx, char *name, FILE *output)
+{
+    struct maze_header *hdr;
+    struct stat st;
+    char  *map;
+    size_t pos;
+    int    fd, num_mazes = 0;
+    int    x, y;
+
+    if ((fd = open(name, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(name);
+        exit(1);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return (0);
+    }
+    if ((map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        perror(name);
+        exit(1);
+    }
+    close(fd);
+
+    for (pos = 0; pos < (size_t)st.st_size; pos += hdr->size) {
+        if (!(hdr = check_maze(map + pos, st.st_size - pos))) {
+            fprintf(stderr, "%s: not a maze file (or not one this version can read)\n", name);
+            exit(1);
+        }
+        load_maze(ctx, hdr);
+        x = ctx->beg_x;
+        y = ctx->beg_y;
+        solve_maze(ctx, &x, &y);
+        num_mazes++;
+
+        if (!output) {
+            print_maze(ctx);
+            continue;
+        }
+        write_output(ctx, output);
+    }
+    munmap(map, st.st_size);                        // compact mazes were using it, so this is the last of them
+    return (num_mazes);
+}
+
+// The least way through worth making a maze for, for --path (or a request) asking for min_len cells: none for 1,
+// or for 0 (or anything a height x width maze can't have) about half the maze, or ten times across it for big ones
+static int path_length_wanted(int height, int width, int min_len)
+{
+    if (min_len < 0 || min_len >= height * width)
+        min_len = 0;
+    if (min_len == 0)
+        min_len = min((height * width) / 2, (int)sqrt(height * width) * 10);
+    return (min_len);
+}
+
+// Serving mazes from a unix socket, out of pools of mazes made ahead of time, one pool for each size class
+// (height, width, depth & least way through) asked for.  Worker threads keep each pool topped up with mazes
+// already written out in the binary format, so handing one out is just a copy to the socket.  A request is one
+// line, "<height> <width> <depth> [<min path length>]", answered with a binary maze (or a line starting with
+// "error:"), or "stats", answered with a line of JSON about each pool.  Asking for a new size class starts a pool
+// for it; that first maze (or any asked for while the pool is empty) waits for a worker to make it.  A class whose
+// way through a worker can't find a long enough one for in MAX_SEED_TRIES seeds is given up on, answering its
+// requests with an error from then on, and size classes can't have more cells, or their pools all together more
+// bytes, than the limits below.
+#define MAX_CLASSES         64                              // most size classes served at once
+#define POOL_SIZE           4                               // mazes kept ready for each by default
+#define MAX_REQUEST         128
+#define MAX_SEED_TRIES      1000                            // seeds tried for a maze before giving up on its class
+#define MAX_SERVE_CELLS     (2048 * 2048)                   // most cells in a maze served
+#define MAX_POOL_BYTES      (256L << 20)                    // most bytes in all the pools' mazes at once
+
+struct pooled_maze {                // ready to be served
+    char     *buf;
+    size_t    size;
+};
+
+struct serve_class {                // one size class and its pool
+    int       height, width, depth, min_len;
+    struct pooled_maze *ready;      // pool_size of them, the first num_ready ready
+    int       num_ready;
+    int       filling;              // mazes being made for it right now
+    int       waiting;              // requests waiting for one
+    long      hits;                 // requests served straight from the pool
+    long      misses;               // and those that had to wait
+    long      made;
+    long      bytes;                // each of its mazes takes
+    int       failed;               // no seed had a long enough way through, so it's not made for any more
+    double    fill_secs;            // making them
+    double    max_fill_secs;
+    double    wait_secs;            // and waiting for them, on a miss
+};
+
+struct serve_type {
+    struct maze_ctx    *ctx;        // settings for the workers' mazes
+    struct serve_class  class[MAX_CLASSES];
+    int       num_classes;
+    int       pool_size;
+    int       workers;
+    int       next_seed;
+    long      pool_bytes;           // all the pools' mazes would take, were they full
+    pthread_mutex_t lock;           // held for everything above
+    pthread_cond_t  refill;         // a pool has room for another maze
+    pthread_cond_t  ready;          // a pool has another maze
+};
+
+static struct serve_type serve;
+
+// The bytes write_maze() writes for a height x width maze
+static long maze_file_size(int height, int width)
+{
+    return ((sizeof(struct maze_header) + 63) / 64 * 64 + 3 * plane_cols(2*width + 3)/8 * plane_rows(2*height + 3));
+}
+
+// Finds the pool for a size class, starting one if need be (NULL if there's no room for another, in error)
+static struct serve_class *find_class(int height, int width, int depth, int min_len, const char **error)
+{
+    struct serve_class *c;
+    long   bytes = maze_file_size(height, width);
+    int    i;
+
+    for (i = 0; i < serve.num_classes; i++) {
+        c = &serve.class[i];
+        if (c->height == height && c->width == width && c->depth == depth && c->min_len == min_len)
+            return (c);
+    }
+    if ((long)height * width > MAX_SERVE_CELLS) {
+        *error = "error: too many cells in a maze that size\n";
+        return (NULL);
+    }
+    if (serve.num_classes == MAX_CLASSES) {
+        *error = "error: too many size classes\n";
+        return (NULL);
+    }
+    if (serve.pool_bytes + serve.pool_size * bytes > MAX_POOL_BYTES) {
+        *error = "error: no room for another pool of mazes that size\n";
+        return (NULL);
+    }
+    c = &serve.class[serve.num_classes];
+    memset(c, 0, sizeof(*c));
+    if (!(c->ready = calloc(serve.pool_size, sizeof(*c->ready)))) {
+        fprintf(stderr, "unable to allocate a maze pool\n");
+        exit(1);
+    }
+    c->height  = height;
+    c->width   = width;
+    c->depth   = depth;
+    c->min_len = min_len;
+    c->bytes   = bytes;
+    serve.pool_bytes += serve.pool_size * bytes;
+    serve.num_classes++;
+    pthread_cond_broadcast(&serve.refill);
+    return (c);
+}
+
+// The pool most in need of another maze: the one with the most requests waiting on it that aren't already being
+// made for, then the emptiest (NULL if they're all full)
+static struct serve_class *neediest_class(void)
+{
+    struct serve_class *c, *best = NULL;
+    int i;
+
+    for (i = 0; i < serve.num_classes; i++) {
+        c = &serve.class[i];
+        if (c->failed || c->num_ready + c->filling >= serve.pool_size)
+            continue;
+        if (!best || c->waiting - c->filling > best->waiting - best->filling ||
+            (c->waiting - c->filling == best->waiting - best->filling && c->num_ready + c->filling < best->num_ready + best->filling))
+            best = c;
+    }
+    return (best);
+}
+
+// Each worker makes mazes for whichever pool needs one most, from the next seed, until it has one with a long
+// enough way through (or has tried MAX_SEED_TRIES seeds, failing the class)
+static void *serve_worker(void *arg)
+{
+    struct maze_ctx    *ctx = new_ctx();
+    struct serve_class *c;
+    struct pooled_maze  m;
+    struct timespec t;
+    double secs;
+    FILE  *fp;
+    int    x, y, long_enough, tries;
+
+    (void)arg;
+    ctx->threads      = serve.ctx->threads;
+    ctx->tile         = serve.ctx->tile;
+    ctx->limit_checks = serve.ctx->limit_checks;
+    ctx->rng          = serve.ctx->rng;
+    ctx->solver       = serve.ctx->solver;
+    pthread_mutex_lock(&serve.lock);
+    for (;;) {
+        while (!(c = neediest_class()))
+            pthread_cond_wait(&serve.refill, &serve.lock);
+        c->filling++;
+        ctx->height = c->height;
+        ctx->width  = c->width;
+        ctx->depth  = c->depth;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        tries = long_enough = 0;
+        do {
+            if (c->failed || ++tries > MAX_SEED_TRIES)
+                break;
+            ctx->seed = serve.next_seed++;
+            ctx->num_maze_created++;
+            pthread_mutex_unlock(&serve.lock);
+            seed_rand(ctx, ctx->seed);
+            ctx->num_solves = ctx->num_wall_push = 0;   // just this maze's, as the utility writes a maze from its seed
+            long_enough = create_maze(ctx, &x, &y, c->min_len) && ctx->max_path_length >= c->min_len;
+            pthread_mutex_lock(&serve.lock);
+        } while (!long_enough);
+        if (!long_enough) {
+            c->filling--;
+            c->failed = 1;
+            pthread_cond_broadcast(&serve.ready);   // for the requests waiting on it to give up
+            continue;
+        }
+        pthread_mutex_unlock(&serve.lock);
+
+        if (!(fp = open_memstream(&m.buf, &m.size))) {
+            perror("open_memstream");
+            exit(1);
+        }
+        write_maze(ctx, fp);
+        fclose(fp);
+        secs = then(&t);
+
+        pthread_mutex_lock(&serve.lock);
+        c->filling--;
+        c->ready[c->num_ready++] = m;
+        c->made++;
+        c->fill_secs    += secs;
+        c->max_fill_secs = max(c->max_fill_secs, secs);
+        pthread_cond_broadcast(&serve.ready);
+    }
+    return (NULL);
+}
+
+static void send_all(int fd, const char *buf, size_t size)
+{
+    ssize_t n;
+
+    for (; size > 0 && (n = send(fd, buf, size, MSG_NOSIGNAL)) > 0; buf += n, size -= n)
+        ;
+}
+
+// Writes a line of JSON about each pool, with the lock held
+static void serve_stats(FILE *fp)
+{
+    struct serve_class *c;
+    int i;
+
+    fprintf(fp, "{ \"version\": \"%s\", \"workers\": %d, \"pool_size\": %d, \"next_seed\": %d, \"pool_bytes\": %ld, \"classes\": [",
+                VERSION, serve.workers, serve.pool_size, serve.next_seed, serve.pool_bytes);
+    for (i = 0; i < serve.num_classes; i++) {
+        c = &serve.class[i];
+        fprintf(fp, "%s { \"height\": %d, \"width\": %d, \"depth\": %d, \"min_path_length\": %d, \"ready\": %d, \"filling\": %d, "
+                    "\"failed\": %s, \"hits\": %ld, \"misses\": %ld, \"hit_rate\": %.4f, \"made\": %ld, \"refill_ms\": %.3f, \"max_refill_ms\": %.3f, \"miss_wait_ms\": %.3f }",
+                    i ? "," : "", c->height, c->width, c->depth, c->min_len, c->num_ready, c->filling,
+                    c->failed ? "true" : "false", c->hits, c->misses, (double)c->hits / max(c->hits + c->misses, 1L), c->made,
+                    1e3 * c->fill_secs / max(c->made, 1L), 1e3 * c->max_fill_secs, 1e3 * c->wait_secs / max(c->misses, 1L));
+    }
+    fprintf(fp, " ] }\n");
+}
+
+// Answers one request on a connection, then closes it
+static void *serve_client(void *arg)
+{
+    int    fd = (intptr_t)arg;
+    char   req[MAX_REQUEST + 1];
+    size_t len = 0;
+    ssize_t n;
+    int    height, width, depth, min_len = 1;
+    struct serve_class *c;
+    struct pooled_maze  m = {};
+    struct timespec t;
+    const char *error = NULL;
+    FILE  *fp;
+
+    while (len < MAX_REQUEST && !memchr(req, '\n', len) && (n = recv(fd, req + len, MAX_REQUEST - len, 0)) > 0)
+        len += n;
+    req[len] = '\0';
+
+    pthread_mutex_lock(&serve.lock);
+    if (!strncmp(req, "stats", 5)) {
+        if ((fp = open_memstream(&m.buf, &m.size))) {
+            serve_stats(fp);
+            fclose(fp);
+        }
+    } else if (sscanf(req, "%d %d %d %d", &height, &width, &depth, &min_len) < 3 ||
+               height <= 0 || height > MAX_SIZE || width <= 0 || width > MAX_SIZE || depth < 0 || depth > MAX_DEPTH) {
+        error = "error: expected <height> <width> <depth> [<min path length>], or stats\n";
+    } else if (min_len > height * width) {          // can't be longer than the cells it goes through
+        error = "error: min path length longer than the maze has cells\n";
+    } else if (!(c = find_class(height, width, depth, path_length_wanted(height, width, min_len), &error))) {
+        ;
+    } else if (c->failed) {
+        error = "error: no maze that size with a way through that long found\n";
+    } else {
+        if (c->num_ready)
+            c->hits++;
+        else {
+            c->misses++;
+            c->waiting++;
+            pthread_cond_broadcast(&serve.refill);
+            clock_gettime(CLOCK_MONOTONIC, &t);
+            while (!c->num_ready && !c->failed)
+                pthread_cond_wait(&serve.ready, &serve.lock);
+            c->wait_secs += then(&t);
+            c->waiting--;
+        }
+        if (c->num_ready) {
+            m = c->ready[--c->num_ready];
+            pthread_cond_broadcast(&serve.refill);
+        } else
+            error = "error: no maze that size with a way through that long found\n";
+    }
+    pthread_mutex_unlock(&serve.lock);
+    if (error) {
+        m.buf  = strdup(error);
+        m.size = strlen(m.buf);
+    }
+
+    send_all(fd, m.buf, m.size);
+    close(fd);
+    free(m.buf);
+    return (NULL);
+}
+
+// Serves mazes from the unix socket at path until killed, starting with a pool of height x width mazes (pool_size
+// of each size class kept ready by worker threads, making mazes with ctx's settings)
+static void serve_mazes(struct maze_ctx *ctx, const char *path, int pool_size, int workers, int min_len)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    pthread_attr_t attr;
+    pthread_t thread;
+    const char *error;
+    int fd, conn, i;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        exit(1);
+    }
+    strcpy(addr.sun_path, path);
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);                               // left over from a server before
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror(path);
+        exit(1);
+    }
+
+    serve.ctx       = ctx;
+    serve.pool_size = pool_size;
+    serve.workers   = workers;
+    serve.next_seed = ctx->seed;
+    pthread_mutex_init(&serve.lock, NULL);
+    pthread_cond_init(&serve.refill, NULL);
+    pthread_cond_init(&serve.ready, NULL);
+    if (!find_class(ctx->height, ctx->width, ctx->depth, min_len, &error)) {
+        fprintf(stderr, "%d x %d: %s", ctx->height, ctx->width, error + strlen("error: "));
+        exit(1);
+    }
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&thread, NULL, serve_worker, NULL)) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (;;) {
+        if ((conn = accept(fd, NULL, NULL)) < 0)
+            continue;
+        if (pthread_create(&thread, &attr, serve_client, (void *)(intptr_t)conn))
+            close(conn);
+    }
+}
+#endif
+
+// The library interface, see maze.h
+struct maze_ctx *maze_new(void)
+{
+    return (new_ctx());
+}
+
+void maze_free(struct maze_ctx *ctx)
+{
+    free_ctx(ctx);
+}
+
+int maze_create(struct maze_ctx *ctx, int width, int height, int depth, int seed)
+{
+    struct timespec t;
+    int x, y;
+
+    if (width <= 0 || width > MAX_SIZE || height <= 0 || height > MAX_SIZE || depth < 0 || depth > MAX_DEPTH)
+        return (-1);
+
+    ctx->width  = width;
+    ctx->height = height;
+    ctx->depth  = depth;
+    ctx->seed   = seed;
+    ctx->num_maze_created++;
+    seed_rand(ctx, seed);
+    carve_maze(ctx, &x, &y, &t);
+    ctx->beg_y = ctx->end_y = 0;                    // no openings yet
+    ctx->has_maze = 1;
+    return (0);
+}
+
+int maze_best_openings(struct maze_ctx *ctx, int *beg_y, int *end_y)
+{
+    struct timespec t;
+    int x, y;
+
+    if (!ctx->has_maze)
+        return (-1);
+    if (!ctx->beg_y) {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        search_best_openings(ctx, &x, &y);
+        ctx->phase_secs[OPENINGS_PHASE] = then(&t);
+    }
+    if (beg_y) *beg_y = ctx->beg_y;
+    if (end_y) *end_y = ctx->end_y;
+    return (ctx->max_path_length);
+}
+
+int maze_solve(struct maze_ctx *ctx)
+{
+    int x, y;
+
+    if (maze_best_openings(ctx, NULL, NULL) < 0)
+        return (-1);
+    restore_maze(ctx);                              // solving again starts over
+    x = ctx->beg_x;
+    y = ctx->beg_y;
+    solve_maze(ctx, &x, &y);
+    return (ctx->path_len);
+}
+
+void maze_watch(struct maze_ctx *ctx, maze_watch_fn *watch, void *arg)
+{
+    ctx->watch     = watch;
+    ctx->watch_arg = arg;
+}
+
+const void *maze_walls(struct maze_ctx *ctx, int *rows, int *cols, long *stride)
+{
+    if (rows) *rows = ctx->max_x;
+    if (cols) *cols = ctx->max_y;
+#ifndef COMPACT_MAZE
+    if (stride) *stride = ctx->maze_stride;
+    return (ctx->maze_cells);
+#else
+    if (stride) *stride = ctx->plane_stride;
+    return (ctx->wall_plane[0]);
+#endif
+}
+
+unsigned long long maze_walls_hash(struct maze_ctx *ctx)
+{
+    return (walls_hash(ctx));
+}
+
+#ifndef LIBMAZE
+int main(int argc, char *argv[])
+{
+    struct maze_ctx *ctx = new_ctx();
+    struct timeval tval;
+    struct option  long_opts[] = {
+        { "bench"  , 0, NULL, 'B' },
+        { "blank"  , 0, NULL, 'b' },
+        { "cell-px", 1, NULL, 'C' },
+        { "checks" , 1, NULL, 'k' },
+        { "count"  , 1, NULL, 'c' },
+        { "depth"  , 1, NULL, 'd' },
+        { "format" , 1, NULL, 'F' },
+        { "fps"    , 1, NULL, 'f' },
+        { "height" , 1, NULL, 'h' },
+        { "input"  , 1, NULL, 'i' },
+        { "jobs"   , 1, NULL, 'j' },
+        { "output" , 1, NULL, 'o' },
+        { "path"   , 2, NULL, 'p' },
+        { "rng"    , 1, NULL, 'R' },
+        { "serve"  , 1, NULL, 'D' },
+        { "show"   , 0, NULL, 's' },
+        { "solver" , 1, NULL, 'S' },
+        { "stats"  , 1, NULL, 'T' },
+        { "stream" , 0, NULL, 'E' },
+        { "threads", 1, NULL, 't' },
+        { "tile"   , 1, NULL, 'x' },
+        { "width"  , 1, NULL, 'w' },
+        { NULL     , 0, NULL,  0  }
+    };
+    int rows = 24;
+    int cols = 80;
+    int opt  =  0;
+    int path_start_x;
+    int path_start_y;
+    int max_height = MAX_SIZE;
+    int max_width  = MAX_SIZE;
+    int def_height = DEFAULT_HEIGHT;
+    int def_width  = DEFAULT_WIDTH;
+    int min_path_length = 1;
+    int tries = 0;
+    int show  = 0;
+    int count = 0;
+    int bench = 0;
+    int stream = 0;
+    int bench_depth = -1;
+    char *output_name = NULL;
+    char *input_name  = NULL;
+    char *serve_name  = NULL;
+    FILE *output      = NULL;
+
+    while ((opt = getopt_long(argc, argv, "BbC:D:Ec:d:f:F:h:i:j:k:o:p::r:R:sS:t:T:w:x:", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'c': count   = atoi(optarg); break;
+            case 'o': output_name =   optarg; break;
+            case 'i': input_name  =   optarg; break;
+            case 'D': serve_name  =   optarg; break;
+            case 'S':
+                for (ctx->solver = 0; ctx->solver < num_solvers && strcmp(optarg, solver_tbl[ctx->solver].name); ctx->solver++)
+                    ;
+                if (ctx->solver == num_solvers) {
+                    fprintf(stderr, "unknown solver %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'T':
+                if (strcmp(optarg, "json")) {
+                    fprintf(stderr, "unknown stats format %s\n", optarg);
+                    exit(1);
+                }
+                stats_on = 1;
+                break;
+            case 'F':
+                if      (!strcmp(optarg, "ascii" )) format = ASCII_FORMAT;
+                else if (!strcmp(optarg, "binary")) format = BINARY_FORMAT;
+                else if (!strcmp(optarg, "csv"   )) format = CSV_FORMAT;
+                else if (!strcmp(optarg, "json"  )) format = JSON_FORMAT;
+                else if (!strcmp(optarg, "pbm"   )) format = PBM_FORMAT;
+                else if (!strcmp(optarg, "png"   )) format = PNG_FORMAT;
+                else {
+                    fprintf(stderr, "unknown format %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'd': ctx->depth   = bench_depth = atoi(optarg); break;
+            case 'k': ctx->limit_checks = atoi(optarg); break;
+            case 'f': fps          = atoi(optarg); break;
+            case 'h': ctx->height  = atoi(optarg); break;
+            case 'w': ctx->width   = atoi(optarg); break;
+            case 'r': ctx->seed    = atoi(optarg); break;
+            case 't': ctx->threads = atoi(optarg); break;
+            case 'x': ctx->tile    = atoi(optarg); break;
+            case 'j': jobs         = atoi(optarg); break;
+            case 'C': cell_px      = atoi(optarg); break;
+            case 'b': blank        = 1           ; break;
+            case 'B': bench        = 1           ; break;
+            case 'E': stream       = 1           ; break;
+            case 's': show         = 1           ; break;
+            case 'R':
+                if      (!strcmp(optarg, "rand")) ctx->rng = RAND_RNG;
+                else if (!strcmp(optarg, "pcg" )) ctx->rng = PCG_RNG;
+                else {
+                    fprintf(stderr, "unknown random number generator %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'p': {
+                char *path_arg = optarg;
+                if (!optarg && argv[optind] && argv[optind][0] != '-')
+                    path_arg = argv[optind++];
+                if (path_arg) min_path_length = atoi(path_arg);
+                else          min_path_length = 0;
+                break;
+            }
+            default :
+                printf("%s\nUsage: %s [options]\n%s", UTS_SIGN_ON, argv[0],
+                       "Options:"                                                                                "\n"
+                       "  -f, --fps     <frames per second>  Set refresh rate           (default: none, instant)""\n"
+                       "  -h, --height  <height>             Set maze height            (default: screen, or 100)""\n"
+                       "  -w, --width   <width>              Set maze width             (default: screen, or 300)""\n"
+                       "  -d, --depth   <depth>              Set path search depth      (default: 1            )""\n"
+                       "  -k, --checks  <checks>             Set look ahead check limit (default: 500000       )""\n"
+                       "  -p, --path   [<length>]            Set minimum path length    (default: none         )""\n"
+                       "  -r, --random  <seed>               Set random number seed     (default: current usec )""\n"
+                       "  -R, --rng     <rand|pcg>           Set random number source   (default: rand         )""\n"
+                       "  -t, --threads <threads>            Set carve & search threads (default: 1            )""\n"
+                       "  -j, --jobs    <jobs>               Set --path seeds at once   (default: 1            )""\n"
+                       "  -x, --tile    <cells>              Set carving tile size      (default: none         )""\n"
+                       "  -s, --show                         Show intermediate results while path length not met""\n"
+                       "  -S, --solver  <solver>             Set dfs/bfs/deadend/astar  (default: dfs          )""\n"
+                       "  -c, --count   <count>              Set number of mazes output (default: 1            )""\n"
+                       "  -o, --output  <filename>           Output mazes to file (or - for stdout) only        ""\n"
+                       "  -F, --format  <format>             Set ascii/binary/pbm/png   (default: ascii        )""\n"
+                       "  -C, --cell-px <pixels>             Set image cell size        (default: 1            )""\n"
+                       "  -T, --stats   <json>               Write stats for each maze and the run to stderr    ""\n"
+                       "  -E, --stream                       Carve & output a row at a time, any height, no -d  ""\n"
+                       "  -B, --bench                        Time making mazes of several sizes & depths instead""\n"
+                       "                                     (-c runs each, -F csv|json, -h, -w & -d pick one)  ""\n"
+                       "  -i, --input   <filename>           Solve binary mazes from file instead of creating any""\n"
+                       "  -D, --serve   <socket>             Serve binary mazes from pools kept ready instead   ""\n"
+                       "                                     (-c per size, -j workers, -h -w -d -p first size)  ""\n"
+                       "  -b, --blank                        Show empty maze as blank vs. lattice work of walls ""\n\n");
+                exit(0);
+                break;
+        }
+    }
+
+    if (bench) {
+        int bench_height = max(ctx->height, 0);
+        int bench_width  = max(ctx->width , 0);
+
+        if (format != CSV_FORMAT)        format = JSON_FORMAT;
+        if (count <= 0)                  count  = BENCH_RUNS;
+        if (!ctx->seed)                  ctx->seed = 1;    // the same mazes every time
+        if (bench_depth > MAX_DEPTH)     bench_depth = MAX_DEPTH;
+        if (ctx->limit_checks <= 0)      ctx->limit_checks = MAX_CHECKS;
+        if (ctx->threads <= 0)           ctx->threads = 1;
+        if (ctx->threads > MAX_THREADS)  ctx->threads = MAX_THREADS;
+        if (!output_name || !strcmp(output_name, "-"))
+            output = stdout;
+        else if (!(output = fopen(output_name, "w"))) {
+            perror(output_name);
+            exit(1);
+        }
+        run_bench(ctx, output, count, min(bench_height, MAX_SIZE), min(bench_width, MAX_SIZE), bench_depth);
+        fclose(output);
+        return (0);
+    }
+    if (format == CSV_FORMAT || format == JSON_FORMAT)
+        format = ASCII_FORMAT;                      // only for benchmark results
+
+    if (count > 0 || output_name || format != ASCII_FORMAT || stream || serve_name) {   // batch mode: no terminal to size, draw on or wait for
+        if (count <= 0)  count = serve_name ? POOL_SIZE : 1;
+        if (!output_name || !strcmp(output_name, "-"))
+            output = stdout;
+        else if (!(output = fopen(output_name, format != ASCII_FORMAT ? "wb" : "w"))) {
+            perror(output_name);
+            exit(1);
+        }
+        setvbuf(output, NULL, _IOFBF, 1 << 16);
+        fps  = 0;
+        show = 0;
+        if (stream)
+            max_height = MAX_STREAM_HEIGHT;
+    } else {
+        get_console_size(&rows, &cols);
+        max_height = (rows - 3)/2;                  // when drawing, the maze has to fit on the screen
+        max_width  = (cols - 1)/4;
+        def_height = max_height;                    // and fills it by default
+        def_width  = max_width;
+    }
+
+    if (ctx->height > max_height || ctx->width > max_width) {    // asked for, but too big
+        if (ctx->height > max_height)
+            fprintf(stderr, "height %d is more than %d, the most%s\n", ctx->height, max_height, output ? "" : " that fits on the screen");
+        else
+            fprintf(stderr, "width %d is more than %d, the most%s\n", ctx->width, max_width, output ? "" : " that fits on the screen");
+        exit(1);
+    }
+    if (ctx->depth   <  0 || ctx->depth   > MAX_DEPTH  ) ctx->depth   = MAX_DEPTH  ;
+    if (fps          <  0 || fps          > 100000     ) fps          = 100000     ;
+    if (ctx->limit_checks <= 0                         ) ctx->limit_checks = MAX_CHECKS;
+    if (ctx->height  <= 0                              ) ctx->height  = def_height ;
+    if (ctx->width   <= 0                              ) ctx->width   = def_width  ;
+    if (ctx->threads <= 0                              ) ctx->threads = 1          ;
+    if (ctx->threads >  MAX_THREADS                    ) ctx->threads = MAX_THREADS;
+    if (jobs         <= 0                              ) jobs         = 1          ;
+    if (jobs         >  MAX_JOBS                       ) jobs         = MAX_JOBS   ;
+    if (cell_px      <= 0 || cell_px      > MAX_CELL_PX) cell_px      = 1          ;
+
+    if (stream) {                                   // no look ahead, openings to search for or solving to wait for
+        if (format != ASCII_FORMAT && format != BINARY_FORMAT) {
+            fprintf(stderr, "streamed mazes can only be ascii or binary\n");
+            exit(1);
+        }
+        if (format == BINARY_FORMAT && fseek(output, 0, SEEK_CUR) < 0) {
+            fprintf(stderr, "binary mazes can only be streamed to a file\n");
+            exit(1);
+        }
+        if (format == BINARY_FORMAT && ctx->height > MAX_SIZE) {    // -i loads a whole maze, so it couldn't read it back
+            fprintf(stderr, "height %d is more than %d, the most a streamed binary maze can be to read back\n", ctx->height, MAX_SIZE);
+            exit(1);
+        }
+        do {
+            if (ctx->num_maze_created++ > 0)
+                ctx->seed++;
+            else if (!ctx->seed) {
+                gettimeofday(&tval, NULL);
+                ctx->seed = tval.tv_usec;
+            }
+            seed_rand(ctx, ctx->seed);
+            stream_maze(ctx, output);
+        } while (--count > 0);
+        fclose(output);
+        return (0);
+    }
+
+    min_path_length = path_length_wanted(ctx->height, ctx->width, min_path_length);
+
+    if (serve_name) {
+        if (!ctx->seed) {
+            gettimeofday(&tval, NULL);
+            ctx->seed = tval.tv_usec;
+        }
+        serve_mazes(ctx, serve_name, count, jobs, min_path_length);
+        return (0);
+    }
+
+    if (!output) {
+        clr_screen();
+        set_cursor_off();
+    }
+
+    if (input_name) {
+        read_mazes(ctx, input_name, output);
+        if (output)
+            fclose(output);
+        else {
+            set_cursor_on();
+            printf("\n");
+        }
+        return (0);
+    }
+
+    do {
+        do {
+            if (ctx->num_maze_created++ > 0 || !ctx->seed) {
+                gettimeofday(&tval, NULL);
+                ctx->seed = (output && ctx->num_maze_created > 1) ? ctx->seed + 1 : tval.tv_usec; // batches use consecutive seeds so none repeat
+            }
+            if (jobs > 1 && min_path_length > 1) {  // find the seed in parallel, then make its maze again here
+                tries = speculate(ctx, min_path_length);
+                ctx->seed             += tries;
+                ctx->num_maze_created += tries;
+            }
+            seed_rand(ctx, ctx->seed);
+
+            if (create_maze(ctx, &path_start_x, &path_start_y, show ? 0 : min_path_length)) {    // too short to bother with otherwise
+                if (show) { print_maze(ctx); sleep(1); }
+                solve_maze(ctx, &path_start_x, &path_start_y); if (show) { print_maze(ctx); sleep(1); }
+            }
+            maze_stats(ctx);
+
+        } while (ctx->max_path_length < min_path_length);
+
+        if (output)
+            write_output(ctx, output);
+    } while (--count > 0);
+
+    if (stats_on)
+        write_stats(ctx, stderr, &run_stats);
+    if (output) {
+        fclose(output);
+        return (0);
+    }
+    print_maze(ctx);
+    set_cursor_on();
+    printf("\n");
+    return (0);
+}
+#endif
@@ -1,215 +1,441 @@
+/*
+ * maze.cpp -- mazes drawn as they're made, on the maze.c engine
+ *
+ * Build the engine as a library (see maze.h) and link with it:
+ *
+ *     cc -O2 -DLIBMAZE -c maze.c && c++ -O2 maze.cpp maze.o -o maze_view -lm -lpthread
+ *
+ * On Windows build both with mingw-w64 (under MSYS2, say), whose winpthreads has the pthreads the engine uses, for
+ * the Win32 console backend.  Cygwin builds them as on any POSIX system, and doesn't define _WIN32, so there it's
+ * the VT100 backend drawing on Cygwin's terminal instead.
+ *
+ * Usage: maze_view [-w width] [-h height] [-d depth] [-f fps] [-r seed] [-c count] [-p] [-v win32|vt100|null]
+ *
+ * Each change the engine makes is a frame, drawn by a render backend: the Win32 console, a VT100 terminal, or
+ * nothing at all (null), which just times making the mazes, for a baseline without any drawing (and hashes the
+ * last one's walls, as regress.sh checks).  With no fps, mazes are drawn once they're done.
+ */
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
 #include <cstdlib>
-#include <iostream.h>
-#include <time.h>
-
-#define MAX_WIDTH   25
-#define MAX_HEIGHT  50
-
-int width  = 0;
-int height = 0;
-
-int delay  = 0;
-int fps    = 0;
-
-HANDLE console_handle;
-COORD  console_origin = {0, 0};
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <chrono>
+#include <thread>
+#include "maze.h"
+
+static int width  = 0;          /* (static, as the engine has globals of its own) */
+static int height = 0;
+static int depth  = 1;
+static int fps    = 0;
+
+typedef unsigned short glyph_t;         /* a character, and whether it's on the way through */
+
+#define SOLVED_GLYPH    0x100
+
+#ifdef _WIN32
+static char cp437_lookup[] = {(char) ' ', (char) 179, (char) 196, (char) 192,
+                              (char) 179, (char) 179, (char) 218, (char) 195,
+                              (char) 196, (char) 217, (char) 196, (char) 193,
+                              (char) 191, (char) 180, (char) 194, (char) 197};
+#endif
+
+static char vt100_lookup[] = {' ' , 0x78, 0x71, 0x6d,       /* DEC special graphics */
+                              0x78, 0x78, 0x6c, 0x74,
+                              0x71, 0x6a, 0x71, 0x76,
+                              0x6b, 0x75, 0x77, 0x6e};
+
+static char state_lookup[] = {' ', ' ', '*', '.'};     /* what's not a wall, by MAZE_ value */
+
+
+/* Where mazes are drawn as they're made */
+class Renderer {
+public:
+        virtual ~Renderer() {}
+        virtual bool watching() { return true; }        /* whether it wants to hear of each change */
+        virtual void start(int, int) {}                 /* a new maze, rows x cols locations, all walls */
+        virtual void change(int, int, int) {}           /* location x, y is now val */
+        virtual void finish() {}                        /* the maze is done */
+};
+
+
+/* Draws nothing, so making mazes can be timed without any drawing at all */
+class NullRenderer : public Renderer {
+public:
+        bool watching() { return false; }
+};
+
+
+/* Draws on a text screen, keeping the maze's text up to date as it changes: two characters for each cell
+   (and wall across) and one for each wall down.  Each change is a frame, fps of them a second, drawing just
+   the part of the screen that changed. */
+class ScreenRenderer : public Renderer {
+public:
+        ScreenRenderer(const char *lookup) : lookup(lookup), grid(NULL), text(NULL) {}
+        ~ScreenRenderer() { delete[] grid; delete[] text; }
+
+        void start(int rows, int cols)
+        {
+                int x, y;
+
+                delete[] grid;
+                delete[] text;
+                this->rows = rows;
+                this->cols = cols;
+                lines      = rows - 2;
+                columns    = column(cols - 2) + 1;
+                grid       = new char[rows * cols];
+                text       = new glyph_t[lines * columns];
+                for (x = 0; x < rows; x++)
+                        for (y = 0; y < cols; y++)
+                                grid[x*cols + y] = (x > 0 && x < rows - 1 && y > 0 && y < cols - 1) ? MAZE_WALL : MAZE_PATH;
+                top  = left  = 0;
+                bottom = lines - 1;
+                right  = columns - 1;
+                for (x = 1; x < rows - 1; x++)
+                        for (y = 1; y < cols - 1; y++)
+                                set_text(x, y);
+                if (fps)
+                        frame();
+        }
 
-bool maze[(MAX_HEIGHT + 1)*2 + 1][(MAX_WIDTH + 1)*2 + 1];
+        void change(int x, int y, int val)
+        {
+                grid[x*cols + y] = val;
+                if (x < 1 || x > rows - 2 || y < 1 || y > cols - 2)
+                        return;         /* the way through leaves through the moat, which isn't drawn */
+                set_text(x, y);
+                if (x > 1)        set_text(x - 1, y);
+                if (x < rows - 2) set_text(x + 1, y);
+                if (y > 1)        set_text(x, y - 1);
+                if (y < cols - 2) set_text(x, y + 1);
+                if (fps)
+                        frame();
+        }
 
-int direction_table[4][2];
+        void finish()
+        {
+                if (bottom >= 0)
+                        draw();
+                bottom = -1;
+        }
 
-char output_lookup[] = {(char) ' ', (char) 179, (char) 196, (char) 192,
-                        (char) 179, (char) 179, (char) 218, (char) 195,
-                        (char) 196, (char) 217, (char) 196, (char) 193,
-                        (char) 191, (char) 180, (char) 194, (char) 197};
+protected:
+        const char *lookup;             /* wall characters, by which of the walls around are walls too */
+        int      rows, cols;            /* maze locations */
+        int      lines, columns;        /* and the text showing them */
+        char    *grid;                  /* each location's MAZE_ value */
+        glyph_t *text;                  /* each character of the text */
+        int      top, left, bottom, right;      /* what's changed since it was last drawn (none if bottom < 0) */
 
-char big_block[]     = {(char) 219, (char) 219, 0};
+        virtual void draw() = 0;        /* puts the changed part of the text on the screen */
+        virtual void wait_frame() = 0;  /* waits until the next frame is due */
 
+        static int column(int y)        /* first character of location y */
+        {
+                return (3*(y - 1)/2);
+        }
 
-void initialize_maze()
-{
-        int i, j;
+        bool wall(int x, int y)
+        {
+                return (grid[x*cols + y] == MAZE_WALL);
+        }
 
-        for (i = 1; i < 2*(height+1); i++)
-                for (j = 1; j < 2*(width+1); j++)
-                        maze[i][j] = 1;
+        void set_text(int x, int y)
+        {
+                int     val = grid[x*cols + y];
+                int     line = x - 1, col = column(y);
+                glyph_t g;
+
+                if (val == MAZE_WALL)
+                        g = (unsigned char) lookup[wall(x-1, y) + 2*wall(x, y+1) + 4*wall(x+1, y) + 8*wall(x, y-1)];
+                else
+                        g = (unsigned char) state_lookup[val & 3] | (val == MAZE_SOLVED ? SOLVED_GLYPH : 0);
+                text[line*columns + col] = g;
+                if (!(y & 1))
+                        text[line*columns + col + 1] = g;
+
+                if (bottom < 0) {
+                        top  = bottom = line;
+                        left = right  = col;
+                }
+                if (line < top)    top    = line;
+                if (line > bottom) bottom = line;
+                if (col  < left)   left   = col;
+                if (col + !(y & 1) > right) right = col + !(y & 1);
+        }
 
-        for (i = 0; i < 2*(height+1) + 1; i++)
-                maze[i][0] = maze[i][2*(width+1)] = 0;
+        void frame()
+        {
+                if (bottom >= 0)
+                        draw();
+                bottom = -1;
+                wait_frame();
+        }
+};
+
+
+#ifdef _WIN32
+/* Draws on the Win32 console, each frame with one WriteConsoleOutput, paced by a waitable timer */
+class Win32Renderer : public ScreenRenderer {
+public:
+        Win32Renderer() : ScreenRenderer(cp437_lookup), buffer(NULL), frame_timer(NULL)
+        {
+                CONSOLE_SCREEN_BUFFER_INFO info;
+
+                console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
+                console_attributes = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
+                if (GetConsoleScreenBufferInfo(console_handle, &info))
+                        console_attributes = info.wAttributes;
+#ifdef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+                frame_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+                if (!frame_timer)       /* before Windows 10 1803, waits are rounded to the clock tick */
+                        frame_timer = CreateWaitableTimer(NULL, TRUE, NULL);
+                QueryPerformanceFrequency(&counts_per_sec);
+                QueryPerformanceCounter(&next_frame);
+        }
 
-        for (j = 0; j < 2*(width+1) + 1; j++)
-                maze[0][j] = maze[2*(height+1)][j] = 0;
-}
+        ~Win32Renderer()
+        {
+                delete[] buffer;
+                if (frame_timer)
+                        CloseHandle(frame_timer);
+        }
 
+        void start(int rows, int cols)
+        {
+                delete[] buffer;
+                buffer = new CHAR_INFO[(rows - 2) * (3*(cols - 3)/2 + 1)];
+                ScreenRenderer::start(rows, cols);
+        }
 
-void print_block_maze()
-{
-        int i, j;
+        void finish()
+        {
+                COORD below = {0, 0};
 
-        SetConsoleCursorPosition(console_handle, console_origin);
-        for (i = 1; i < 2*(height+1); i++) {
-                for (j = 1; j < 2*(width+1); j++) {
-                        cout << (maze[i][j] ? big_block : "  ");
-                }
-                cout << endl;
+                ScreenRenderer::finish();
+                below.Y = lines + 1;
+                SetConsoleCursorPosition(console_handle, below);
         }
-        cout << endl;
-}
 
-
-void print_line_maze()
-{
-        int i, j;
-
-        SetConsoleCursorPosition(console_handle, console_origin);
-        for (i = 1; i < 2*(height+1); i++) {
-                for (j = 1; j < 2*(width+1); j++) {
-                        if (maze[i][j]) {
-                                cout << output_lookup[maze[i-1][j] + 2*maze[i][j+1] + 4*maze[i+1][j] + 8*maze[i][j-1]];
-                                if (!(j & 1))
-                                        cout << output_lookup[maze[i-1][j] + 2*maze[i][j+1] + 4*maze[i+1][j] + 8*maze[i][j-1]];
-                        }
-                        else {
-                                cout << " ";
-                                if (!(j & 1))
-                                        cout << " ";
+protected:
+        HANDLE        console_handle;
+        WORD          console_attributes;
+        CHAR_INFO    *buffer;           /* the text, as the console has it */
+        HANDLE        frame_timer;
+        LARGE_INTEGER counts_per_sec;
+        LARGE_INTEGER next_frame;       /* when the next frame is due */
+
+        void draw()
+        {
+                COORD      size = {(SHORT) columns, (SHORT) lines};
+                COORD      from = {(SHORT) left, (SHORT) top};
+                SMALL_RECT region = {(SHORT) left, (SHORT) top, (SHORT) right, (SHORT) bottom};
+                int        i, j;
+
+                for (i = top; i <= bottom; i++)
+                        for (j = left; j <= right; j++) {
+                                glyph_t g = text[i*columns + j];
+
+                                buffer[i*columns + j].Char.AsciiChar = (char) g;
+                                buffer[i*columns + j].Attributes     = (g & SOLVED_GLYPH) ? FOREGROUND_GREEN | FOREGROUND_INTENSITY : console_attributes;
                         }
+                WriteConsoleOutputA(console_handle, buffer, size, from, &region);
+        }
+
+        /* Each frame is due a 1/fps after the last was due, by the performance counter */
+        void wait_frame()
+        {
+                LARGE_INTEGER now, due;
+
+                next_frame.QuadPart += counts_per_sec.QuadPart / fps;
+                QueryPerformanceCounter(&now);
+                if (now.QuadPart - next_frame.QuadPart > counts_per_sec.QuadPart/4)
+                        next_frame = now;       /* too far behind to catch up, so start again from now */
+                else if (next_frame.QuadPart > now.QuadPart) {
+                        due.QuadPart = -((next_frame.QuadPart - now.QuadPart) * 10000000 / counts_per_sec.QuadPart);
+                        if (frame_timer && SetWaitableTimer(frame_timer, &due, 0, NULL, NULL, FALSE))
+                                WaitForSingleObject(frame_timer, INFINITE);
+                        else
+                                Sleep((DWORD)((next_frame.QuadPart - now.QuadPart) * 1000 / counts_per_sec.QuadPart));
                 }
-                cout << endl;
         }
-        cout << endl;
-        for (i = 0; i < delay; i++)
-                j = j*i;
-}
+};
+#endif
 
 
-int find_directions(int x, int y)
-{
-        int possible_directions = 0;
+/* Draws on a VT100 terminal (or anything emulating one), each frame with one write */
+class Vt100Renderer : public ScreenRenderer {
+public:
+        Vt100Renderer() : ScreenRenderer(vt100_lookup), next_frame(std::chrono::steady_clock::now()) {}
 
-        if (maze[x-2][y]) {             /* look left */
-                direction_table[possible_directions][0] = -2;
-                direction_table[possible_directions][1] = 0;
-                possible_directions++;
+        void start(int rows, int cols)
+        {
+                printf("\033[2J\033[?25l\033(0");       /* clear, cursor off, line drawing */
+                ScreenRenderer::start(rows, cols);
         }
 
-        if (maze[x+2][y]) {             /* look right */
-                direction_table[possible_directions][0] = 2;
-                direction_table[possible_directions][1] = 0;
-                possible_directions++;
+        void finish()
+        {
+                ScreenRenderer::finish();
+                printf("\033(B\033[%d;1H\033[?25h", lines + 2);
+                fflush(stdout);
         }
 
-        if (maze[x][y-2]) {             /* look up */
-                direction_table[possible_directions][0] = 0;
-                direction_table[possible_directions][1] = -2;
-                possible_directions++;
+protected:
+        std::string out;
+        std::chrono::steady_clock::time_point next_frame;
+
+        void draw()
+        {
+                char    pos[32];
+                int     i, j, solved = 0;
+
+                out.clear();
+                for (i = top; i <= bottom; i++) {
+                        snprintf(pos, sizeof(pos), "\033[%d;%dH", i + 1, left + 1);
+                        out += pos;
+                        for (j = left; j <= right; j++) {
+                                glyph_t g = text[i*columns + j];
+
+                                if (!(g & SOLVED_GLYPH) != !solved)
+                                        out += (solved = g & SOLVED_GLYPH) ? "\033[32m\033[1m" : "\033[0m";
+                                out += (char) g;
+                        }
+                }
+                if (solved)
+                        out += "\033[0m";
+                fwrite(out.data(), 1, out.size(), stdout);
+                fflush(stdout);
         }
 
-        if (maze[x][y+2]) {             /* look down */
-                direction_table[possible_directions][0] = 0;
-                direction_table[possible_directions][1] = 2;
-                possible_directions++;
-        }
+        void wait_frame()
+        {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
-        return(possible_directions);
-}
+                next_frame += std::chrono::nanoseconds(1000000000LL / fps);
+                if (now - next_frame > std::chrono::milliseconds(250))
+                        next_frame = now;       /* too far behind to catch up, so start again from now */
+                else
+                        std::this_thread::sleep_until(next_frame);
+        }
+};
 
 
-int find_path_start(int *path_x, int *path_y)
+void watch_change(void *arg, int x, int y, int val)
 {
-        int i, x_start;
-        int j, y_start;
-
-        i = x_start = rand() % height;
-        j = y_start = rand() % width;
-
-        for (i = ++i % height; i != x_start; i = ++i % height)
-                for (j = ++j % width; j != y_start; j = ++j % width) {
-                        *path_x = 2*(i + 1);
-                        *path_y = 2*(j + 1);
-                        if (maze[*path_x][*path_y] == 0 && find_directions(*path_x, *path_y) != 0)
-                                return(1);
-                }
-        return (0);
+        ((Renderer *) arg)->change(x, y, val);
 }
 
 
-/*int find_path_start(int *i, int *j)
+void get_console_size(int *rows, int *cols)
 {
-        for (*i = 2; *i <= 2*height; *i += 2)
-                for (*j = 2; *j < 2*width; *j += 2)
-                        if (find_directions(*i, *j))
-                                return(1);
-        return(0);
-}*/
-
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
 
-void carve_path(int x, int y)
-{
-        int possible_directions;
-        int direction;
-
-        maze[x][y] = 0;
-        print_line_maze();
-        while (possible_directions = find_directions(x, y)) {
-                direction = rand() % possible_directions;
-                maze[x +  direction_table[direction][0]/2][y +  direction_table[direction][1]/2] = 0;
-                print_line_maze();
-                maze[x += direction_table[direction][0]  ][y += direction_table[direction][1]  ] = 0;
-                print_line_maze();
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+                *rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+                *cols = info.srWindow.Right - info.srWindow.Left + 1;
         }
-}
-
-
-void create_openings()
-{
-        int start, finish;
-
-        start  = rand() % width;
-        finish = rand() % width;
+#else
+        struct winsize ws;
 
-        maze[1]           [2*(start  + 1)] = 0;
-        maze[2*height + 1][2*(finish + 1)] = 0;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+                *rows = ws.ws_row;
+                *cols = ws.ws_col;
+        }
+#endif
 }
 
 
-void main()
+int main(int argc, char *argv[])
 {
-        int path_start_x;
-        int path_start_y;
-
-        srand(time(NULL));
-        console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-
-        while (width <= 0 || width > MAX_WIDTH) {
-                cout << "input width:  ";
-                cin  >> width;
-                if (width <= 0 || width > MAX_WIDTH)
-                        cout << "invalid width, try again" << endl << endl;
-        }
-        while (height <= 0 || height > MAX_HEIGHT) {
-                cout << "input height: ";
-                cin  >> height;
-                if (height <= 0 || height > MAX_HEIGHT)
-                        cout << "invalid height, try again" << endl << endl;
+        Renderer        *renderer = NULL;
+        struct maze_ctx *ctx;
+        const char      *view  = NULL;
+        int              seed  = (int) time(NULL);
+        int              count = 1;
+        int              solve = 0;
+        int              rows  = 24;
+        int              cols  = 80;
+        int              i, n, beg_y, end_y, len = 0;
+        long             cells = 0;
+
+        for (i = 1; i < argc; i++) {
+                const char *arg = i + 1 < argc ? argv[i + 1] : "";
+
+                if      (!strcmp(argv[i], "-w")) { width  = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-h")) { height = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-d")) { depth  = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-f")) { fps    = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-r")) { seed   = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-c")) { count  = atoi(arg); i++; }
+                else if (!strcmp(argv[i], "-v")) { view   = arg;       i++; }
+                else if (!strcmp(argv[i], "-p"))   solve  = 1;
+                else {
+                        printf("usage: %s [-w width] [-h height] [-d depth] [-f fps] [-r seed] [-c count] [-p] [-v win32|vt100|null]\n", argv[0]);
+                        return (1);
+                }
         }
-        while (fps <= 0) {
-                cout << "input fps:    ";
-                cin  >> fps;
-                if (fps <= 0)
-                        cout << "invalid fps, try again" << endl << endl;
+#ifdef _WIN32
+        if (!view || !strcmp(view, "win32"))
+                renderer = new Win32Renderer();
+#else
+        if (!view)
+                view = "vt100";
+#endif
+        if (view && !strcmp(view, "vt100"))
+                renderer = new Vt100Renderer();
+        else if (view && !strcmp(view, "null"))
+                renderer = new NullRenderer();
+        if (!renderer) {
+                fprintf(stderr, "unknown view %s\n", view);
+                return (1);
         }
-        delay = 150000000 / fps;
 
-        initialize_maze();
-
-        carve_path(2*((rand() % height) + 1), 2*((rand() % width)  + 1));
-
-        while (find_path_start(&path_start_x, &path_start_y)) {
-                carve_path(path_start_x, path_start_y);
+        if (renderer->watching()) {             /* the maze has to fit on the screen */
+                get_console_size(&rows, &cols);
+                if (width  > (cols - 1)/3) width  = (cols - 1)/3;
+                if (height > (rows - 2)/2) height = (rows - 2)/2;
         }
-        create_openings();
-
-        print_line_maze();
+        if (width  <= 0) width  = (cols - 1)/3;         /* as big as the screen (or an 80 x 24 one) by default */
+        if (height <= 0) height = (rows - 2)/2;
+        if (fps   < 0) fps   = 0;
+        if (count < 1) count = 1;
+
+        ctx = maze_new();
+        if (renderer->watching())
+                maze_watch(ctx, watch_change, renderer);
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (n = 0; n < count; n++) {
+                renderer->start(2*height + 3, 2*width + 3);
+                if (maze_create(ctx, width, height, depth, seed + n) < 0) {
+                        fprintf(stderr, "can't make a %d x %d maze %d deep\n", height, width, depth);
+                        return (1);
+                }
+                len = maze_best_openings(ctx, &beg_y, &end_y);
+                renderer->change(1, beg_y, MAZE_PATH);
+                renderer->change(2*height + 1, end_y, MAZE_PATH);
+                if (solve)
+                        len = maze_solve(ctx);
+                renderer->finish();
+                cells += (long) width * height;
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        if (!renderer->watching())
+                printf("%d %d x %d mazes, depth %d%s: %.3f s, %.3f ms each, %.0f cells/s (last way through %d cells, walls hash %016llx)\n",
+                       count, height, width, depth, solve ? ", solved" : "", secs, 1e3 * secs / count, cells / secs, len,
+                       maze_walls_hash(ctx));
+        maze_free(ctx);
+        delete renderer;
+        return (0);
 }
@@ -15,11 +15,14 @@
  * Rev 2.1 -- added multi-threaded generation
  * Rev 2.2 -- improved (more efficient) look ahead
  * Rev 2.3 -- added multi-threaded solving
+ * Rev 2.4 -- push mid wall openings from a worklist after one sweep, instead of sweeping until there are none
+ * Rev 2.5 -- add --stats=json, writing counts, phase times and a hash of the walls for each maze to stderr
  */
 package main
 
 import (
     "os"
+    "container/heap"
     "fmt"
     "bufio"
     "flag"
@@ -30,7 +33,7 @@ import (
 )
 
 const (
-    version      = "2.3"
+    version      = "2.5"
     utsSignOn    = "\n" + "Maze Generation Console Utility "+ version +
                    "\n" + "Copyright (c) 2016-2020" +
                    "\n\n"
@@ -71,6 +74,13 @@ const (
     upTee        = 0x76 // '+'
     downTee      = 0x77 // '+'
     vertical     = 0x78 // '|'
+
+    initPhase     = 0   // phases of making a maze, each timed separately (as maze.c names them)
+    carvePhase    = 1
+    pushPhase     = 2
+    openingsPhase = 3
+    solvePhase    = 4
+    numPhases     = 5
 )
 
 type dirTable struct {
@@ -96,6 +106,7 @@ var (
                               '+', '+', '+', '+' }
 
     maze[maxXSize][maxYSize]  int32
+    journal[maxXSize*maxYSize] int32   // locations solving changed from paths (x*maxYSize + y), for restoreMaze to change back
 
     blankFlag         bool
     showFlag          bool
@@ -127,15 +138,20 @@ var (
     numWallPush       int32
     numMazeCreated    int32
     numCheckExceeded  int32
+    journalLen        int32
     maxChecks         int32
     dspLength         int32
     dspNumChecks      int32
     solveLength       int32
     sumsolveLength    int32
 
+    phaseSecs         [numPhases]float64
+    phaseNames        = [numPhases]string { "initialize", "carve", "push", "openings", "solve" }
+
     myStdout          *bufio.Writer
     curFunc           string
     outputName        string
+    statsFormat       string
     displayChan       chan struct{}
     finishChan        chan struct{}
 )
@@ -180,12 +196,45 @@ func clrChecked()              {; fmt.Fprintf(myStdout, "\033[30m\033[0m"  ); my
 func getConsoleSize() (int, int) {
     cols, rows, err := terminal.GetSize(0)
     if err != nil {
-        rows = 24
-        cols = 80
+        rows = 2*maxHeight + 3 // no terminal to fit the maze on (run from a script, say),
+        cols = 4*maxWidth  + 1 // so it can be as big as the maze array allows
     }
     return rows, cols
 }
 
+// timePhase adds the time since start to phase, returning the time now to start the next phase from
+func timePhase(phase int, start time.Time) time.Time {
+    now := time.Now()
+    phaseSecs[phase] += now.Sub(start).Seconds()
+    return now
+}
+
+// wallsHash returns the FNV-1a hash of whether each location is a wall, row by row, just as maze.c hashes its mazes
+func wallsHash() uint64 {
+    hash := uint64(14695981039346656037)
+    for i := 0; i < getInt(&maxX); i++ {
+        for j := 0; j < getInt(&maxY); j++ {
+            hash = (hash ^ uint64(bool2int(getMaze(i, j) == wall))) * 1099511628211
+        }
+    }
+    return hash
+}
+
+// writeStats writes one line of JSON to stderr with the counts and phase times for the last maze
+func writeStats() {
+    fmt.Fprintf(os.Stderr, "{ \"maze\": %d, \"seed\": %d, \"height\": %d, \"width\": %d, \"depth\": %d, \"maze_len\": %d, \"num_paths\": %d, " +
+                           "\"max_path_length\": %d, \"num_wall_push\": %d, \"walls_hash\": \"%016x\", \"phase_ms\": { ",
+                getInt(&numMazeCreated), seed, height, width, depthVal, getInt(&mazeLen), getInt(&numPaths),
+                getInt(&solveLength), getInt(&numWallPush), wallsHash())
+    for p := 0; p < numPhases; p++ {
+        if p > 0 {
+            fmt.Fprintf(os.Stderr, ", ")
+        }
+        fmt.Fprintf(os.Stderr, "\"%s\": %.3f", phaseNames[p], 1e3 * phaseSecs[p])
+    }
+    fmt.Fprintf(os.Stderr, " } }\n")
+}
+
 // initializeMaze sets the entire maze to walls and creates a path around the perimeter to bound the maze.
 // The maximum x, y values are set, and the initial x, y values are set to random values.
 func initializeMaze(x, y *int) {
@@ -194,6 +243,7 @@ func initializeMaze(x, y *int) {
     clrInt(&numThreads      )
     clrInt(&numPaths        )
     clrInt(&numCheckExceeded)
+    clrInt(&journalLen      )
 
     setInt(&maxX, 2*(height + 1) + 1)
     setInt(&maxY, 2*(width  + 1) + 1)
@@ -213,15 +263,25 @@ func initializeMaze(x, y *int) {
     setInt(&endX, 2*height)            // never change
 }
 
+// journalMaze records that location x, y was changed from a path while solving (each location is only changed
+// from a path once per solve, since solving never changes anything back to a path)
+func journalMaze(x, y int)  {
+    journal[atomic.AddInt32(&journalLen, 1) - 1] = int32(x*maxYSize + y)
+}
+
 // restoreMaze returns the maze to a pre-solved state by changing solved or tried cells back to paths.
+// Only the locations in the journal were changed, so only they have to be changed back.
 func restoreMaze()  {
-    for i := 0; i < getInt(&maxX); i++ {
-        for j := 0; j < getInt(&maxY); j++ {
-            if (getMaze(i, j) == solved ||
-                getMaze(i, j) == tried) {
-                setMaze(i, j,    path )
-            }
-        }
+    for i := 0; i < getInt(&journalLen); i++ {
+        setMaze(int(journal[i]) / maxYSize, int(journal[i]) % maxYSize, path)
+    }
+    clrInt(&journalLen)
+}
+
+// solveMark sets location x, y to solved, recording it in the journal if it was a path
+func solveMark(x, y int)  {
+    if setMaze(x, y, solved) == path {
+        journalMaze(x, y)
     }
 }
 
@@ -366,6 +426,9 @@ func setCell(x, y, value int, update bool, length, numChecks int) bool {
     if priorValue == value {
         return false
     }
+    if priorValue == path && (value == solved || value == tried) {
+        journalMaze(x, y)
+    }
     if (update || (getBool(&checkFlag) && getMaze(x, y) == check)) && getInt(&delay) > 0 && fps <= 1000 && isEven(x) && isEven(y) {
         updateMaze(numChecks)
     }
@@ -656,8 +719,8 @@ func solveMaze(x, y *int) {
     setInt( &pathLen   , 0)
     setInt( &turnCnt   , 0)
 
-    setMaze(getInt(&begX) - 2, getInt(&begY), solved)
-    setMaze(getInt(&begX) - 1, getInt(&begY), solved)
+    solveMark(getInt(&begX) - 2, getInt(&begY))
+    solveMark(getInt(&begX) - 1, getInt(&begY))
     if threads > 1 {
         setInt(&numThreads, 1)
         go solve(*x, *y)
@@ -667,8 +730,8 @@ func solveMaze(x, y *int) {
            backTrackPath(x, y)
         }
     }
-    setMaze(getInt(&endX) + 1, getInt(&endY), solved)
-    setMaze(getInt(&endX) + 2, getInt(&endY), solved)
+    solveMark(getInt(&endX) + 1, getInt(&endY))
+    solveMark(getInt(&endX) + 2, getInt(&endY))
     setBool(&checkFlag, saveCheck)
     setInt( &depth    , saveDepth)
 }
@@ -743,29 +806,81 @@ func midWallOpening(x, y int) bool {
            getMaze(x + 1, y + 1) != wall
 }
 
-// pushMidWallOpenings loops over all locations in the maze searching for mid wall openings and pushes horizontal
-// openings to the right, and vertical openings down, and then returns the number of mid wall openings moved.
+// wallHeap holds wall locations to look at again, as x*maxYSize + y, smallest first (a container/heap)
+type wallHeap []int
+
+func (h wallHeap) Len() int            { return len(h) }
+func (h wallHeap) Less(i, j int) bool  { return h[i] < h[j] }
+func (h wallHeap) Swap(i, j int)       { h[i], h[j] = h[j], h[i] }
+func (h *wallHeap) Push(v interface{}) { *h = append(*h, v.(int)) }
+func (h *wallHeap) Pop() interface{}   { old := *h; v := old[len(old) - 1]; *h = old[:len(old) - 1]; return v }
+
+// queueMidWalls queues the wall at x, y and those diagonally next to it, all of whose midWallOpening it changing
+// may change: in this sweep (queue[0]) if the sweep hasn't got past them yet, otherwise in the next (queue[1])
+func queueMidWalls(queue *[2]wallHeap, pos, x, y int) {
+    for k := 0; k < 5; k++ {
+        wx, wy := x, y
+        if k < 4 {
+            wx, wy = x + 2*(k >> 1) - 1, y + 2*(k & 1) - 1
+        }
+        if wx < 1 || wx >= 2 * (height + 1) || wy < 1 || wy >= 2 * (width + 1) {
+            continue
+        }
+        at := wx*maxYSize + wy
+        if at <= pos {
+            heap.Push(&queue[1], at)
+        } else {
+            heap.Push(&queue[0], at)
+        }
+    }
+}
+
+// pushMidWall pushes a mid wall opening at i, j right (horizontal openings) or down (vertical openings), if there
+// is one, and queues the walls that changes
+func pushMidWall(queue *[2]wallHeap, pos, i, j int) int {
+    if !midWallOpening(i, j) {
+        return 0
+    }
+    x, y := i + 2, j                                   // push down
+    if isOdd(i) {
+        x, y = i, j + 2                                 // push right
+    }
+    setCell(i, j, wall, noUpdate, 0, 0)
+    setCell(x, y, path, update, 0, 0)
+    incInt(&numWallPush)
+    queueMidWalls(queue, pos, i, j)
+    queueMidWalls(queue, pos, x, y)
+    return 1
+}
+
+// pushMidWallOpenings pushes mid wall openings right or down until there are none, just as sweeping the whole
+// maze again and again until a sweep found none would, but sweeping it only once: after that, each sweep looks at
+// just the walls a push in the sweep before might have changed, in the same order, along with any the pushes in it
+// change further on.
 func pushMidWallOpenings() {
-    for {
-        moves := 0
-        for i := 1; i < 2 * (height + 1); i++ {
-            for j := (i & 1) + 1; j < 2 * (width + 1); j += 2 {
-                if (midWallOpening(i, j)) {
-                    setCell(i, j, wall, noUpdate, 0, 0)
-                    if isOdd(i) {; setCell(i,  j + 2, path, update, 0, 0)   // push right
-                    } else {;      setCell(i + 2,  j, path, update, 0, 0)   // push down
-                    }
-                    moves++
-                    incInt(&numWallPush)
-                }
-            }
+    var queue [2]wallHeap
+
+    for i := 1; i < 2 * (height + 1); i++ {
+        for j := (i & 1) + 1; j < 2 * (width + 1); j += 2 {
+            pushMidWall(&queue, i*maxYSize + j, i, j)
         }
+    }
+    queue[0] = queue[0][:0]                             // the sweep got to those anyway
+    for {
         if getInt(&delay) > 0 {
             updateMaze(0)
         }
-        if moves == 0 {
+        if len(queue[1]) == 0 {
             break
         }
+        queue[0], queue[1] = queue[1], queue[0]
+        for last := -1; len(queue[0]) > 0; {
+            pos := heap.Pop(&queue[0]).(int)
+            if pos != last {
+                pushMidWall(&queue, pos, pos / maxYSize, pos % maxYSize)
+            }
+            last = pos
+        }
     }
 }
 
@@ -790,11 +905,12 @@ func carveRoutine() {
 // Following this it then repeatedly pushes mid wall openings right or down until there are no longer any mid wall openings.
 // Lastly it searches for the best openings, top and bottom, to create the maze with the longest solution path.
 func createMaze(x, y *int) {
-    initializeMaze(x, y)
+    start := time.Now()
+    initializeMaze(x, y);    start = timePhase(initPhase    , start)
     carvePaths(*x, *y)
-    waitThreadsDone()
-    pushMidWallOpenings()
-    searchBestOpenings(x, y)
+    waitThreadsDone();       start = timePhase(carvePhase   , start)
+    pushMidWallOpenings();   start = timePhase(pushPhase    , start)
+    searchBestOpenings(x, y);        timePhase(openingsPhase, start)
 }
 
 // maze main parses the command line switches and then repeatedly creates and
@@ -814,7 +930,8 @@ func main() {
              "  -v, --view                         Show intermediate results determining maze solution" + "\n" +
              "  -l, --look                         Show look ahead path searches while creating maze  " + "\n" +
              "  -b, --blank                        Show empty maze as blank vs. lattice work of walls " + "\n" +
-             "  -o, --output  <filename>           Output portable ASCII encoded maze when completed  " + "\n\n")
+             "  -o, --output  <filename>           Output portable ASCII encoded maze when completed  " + "\n" +
+             "  -T, --stats   <json>               Write stats for each maze to stderr                " + "\n\n")
     }
     rows, cols := getConsoleSize()
     maxHeight  := min(maxHeight, (rows - 3)/2)
@@ -847,8 +964,14 @@ func main() {
     flag.BoolVar(  &blankFlag , "b"      , false    , "blank walls     (shorthand)");
     flag.StringVar(&outputName, "output" , ""       , "output ascii"               );
     flag.StringVar(&outputName, "o"      , ""       , "output ascii    (shorthand)");
+    flag.StringVar(&statsFormat, "stats" , ""       , "stats format"               );
+    flag.StringVar(&statsFormat, "T"     , ""       , "stats format    (shorthand)");
 
     flag.Parse()
+    if statsFormat != "" && statsFormat != "json" {
+        fmt.Fprintf(os.Stderr, "unknown stats format %s (only json)\n", statsFormat)
+        os.Exit(1)
+    }
 
     if depthVal <  0 || depthVal > 100            {; depthVal = 100           ;}
     if fps      <  0 || fps      > 100000         {; fps      = 100000        ;}
@@ -879,8 +1002,14 @@ func main() {
         var pathStartX int
         var pathStartY int
 
+        phaseSecs = [numPhases]float64{}
         createMaze(&pathStartX, &pathStartY); if showFlag {; updateMaze(0);  msSleep(1000); }
-         solveMaze(&pathStartX, &pathStartY); if showFlag {; updateMaze(0);  msSleep(1000); }
+        start := time.Now()
+         solveMaze(&pathStartX, &pathStartY); timePhase(solvePhase, start)
+                                              if showFlag {; updateMaze(0);  msSleep(1000); }
+        if statsFormat != "" {
+            writeStats()
+        }
 
         if getInt(&solveLength) >= minLen {
            break
@@ -0,0 +1,67 @@
+/*
+ * maze.h -- making & solving mazes from a program, instead of through the maze utility
+ *
+ * Build the engine without its command line, and link with that:
+ *
+ *     cc -O2 -DLIBMAZE -c maze.c && ar rcs libmaze.a maze.o                  (static)
+ *     cc -O2 -DLIBMAZE -fPIC -shared maze.c -o libmaze.so -lm -lpthread       (shared)
+ *
+ * A context holds one maze at a time, along with everything needed to make it, so each thread
+ * making mazes needs a context of its own.  Out of memory is fatal, as it is for the utility.
+ */
+#ifndef MAZE_H
+#define MAZE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAZE_API_VERSION    3
+
+#define MAZE_PATH           0                               // what maze_walls() locations hold
+#define MAZE_WALL           1
+#define MAZE_SOLVED         2                               // on the way through, once solved
+#define MAZE_TRIED          3                               // looked at by the solver, but a dead end
+
+struct maze_ctx;
+
+struct maze_ctx *maze_new (void);
+void             maze_free(struct maze_ctx *ctx);
+
+// Carves a new height x width maze from seed (the same seed always makes the same maze), looking ahead
+// depth cells (0 to 100) so paths don't box themselves in.  Returns 0, or -1 if the size or depth is out of range.
+int maze_create(struct maze_ctx *ctx, int width, int height, int depth, int seed);
+
+// Chooses the top & bottom openings with the longest way through, returning its length in cells and the openings'
+// columns (2, 4, ... 2*width) in beg_y & end_y (either may be NULL).  Only searches once per maze.  Returns -1 if
+// maze_create() hasn't made one yet.
+int maze_best_openings(struct maze_ctx *ctx, int *beg_y, int *end_y);
+
+// Calls watch(arg, x, y, val) as each location changes while carving or solving (x, y and val as maze_walls() has
+// them), from the thread making the maze, so it can be drawn as it's made.  Carving starts from every cell walled
+// in, and openings aren't changes: maze_best_openings() returns them.  A NULL watch stops calling.
+typedef void maze_watch_fn(void *arg, int x, int y, int val);
+void maze_watch(struct maze_ctx *ctx, maze_watch_fn *watch, void *arg);
+
+// Marks the way through (choosing the openings first if need be), returning its length in cells (-1 with no maze).
+int maze_solve(struct maze_ctx *ctx);
+
+// The maze itself, not a copy, good until the next maze_create().  Location x, y (0 <= x < rows, 0 <= y < cols)
+// is a cell when x & y are both even, a wall between cells when just one is odd, and a post when both are.  It's
+// ((const char *)walls)[x*stride + y], one of the MAZE_ values.  A maze.c built with -DCOMPACT_MAZE keeps walls as
+// three bit-planes of stride bits a row instead, and returns the first: location x, y is bit (x/2 + 1)*stride + y/2 + 1
+// of the plane of cells (both even), the plane of right walls after it (y odd) or the plane of down walls after that
+// (x odd), set for a wall.  Posts are always walls.  One built with -DBLOCKED_MAZE keeps the same bytes in square
+// blocks of 8 x 8 locations (unless built with another BLOCK_BITS), each block's rows together and the rows of blocks
+// stride apart: location x, y is ((const char *)walls)[(x + 2)/8*stride + (y + 2)/8*64 + (x + 2)%8*8 + (y + 2)%8].
+const void *maze_walls(struct maze_ctx *ctx, int *rows, int *cols, long *stride);
+
+// FNV-1a hash of whether each location is a wall, row by row, whether solved or not.  It's the same for the same
+// maze however maze.c was built, and maze.go --stats=json hashes its mazes the same way.
+unsigned long long maze_walls_hash(struct maze_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
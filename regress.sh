@@ -0,0 +1,173 @@
+#!/bin/sh
+#
+# regress.sh -- checks maze.c, maze.go and maze_view still make the mazes they always have, and as fast
+#
+# Usage: ./regress.sh [-g] [-n runs] [-s baseline] [-b baseline] [-t percent]
+#
+#     -g             record each maze's walls hash in regress.golden, instead of checking them against it
+#     -n <runs>      make each maze this many times, timing the fastest           (default: 3)
+#     -s <file>      save the times to file, as a baseline for -b
+#     -b <file>      fail if an implementation is slower than it was in file by more than -t percent
+#     -t <percent>   throughput regression allowed                                (default: 10)
+#
+# Each implementation makes a maze for every size, depth & seed in the matrix below, from the utility's own
+# --stats=json (maze_view's null backend just times the mazes, so its line is read instead):
+#
+#     c       maze.c
+#     c-t4    maze.c, searching for the openings with 4 threads
+#     view    maze_view -v null, maze.cpp on the maze.c engine
+#     go      maze.go (unthreaded, so its mazes are reproducible)
+#
+# The first three are the same engine, so they have to make exactly the same mazes: the same walls hash (FNV-1a
+# of whether each location is a wall, see maze_walls_hash() in maze.h) as each other and as regress.golden has.
+# maze.go carves with its own random numbers, so its mazes are its own, but it has golden hashes of its own and
+# both have to make perfect mazes (every cell carved, maze_len one less than the number of cells).
+#
+# The engine is built here with cc & c++ (or $CC & $CXX).  maze.go needs golang.org/x/crypto to build, so it's
+# built with go build if that works, or set MAZE_GO to a maze.go already built; without either it's skipped.
+#
+SIZES="10x20 20x40 40x80"                       # height x width (maze.go finds openings in O(width^2) solves)
+DEPTHS="0 1 2 5"
+SEEDS="1 2 3"
+
+golden=regress.golden
+runs=3
+threshold=10
+generate=0
+save=
+baseline=
+
+while getopts gn:s:b:t: opt; do
+    case $opt in
+        g) generate=1 ;;
+        n) runs=$OPTARG ;;
+        s) save=$OPTARG ;;
+        b) baseline=$OPTARG ;;
+        t) threshold=$OPTARG ;;
+        *) sed -n '5,11p' "$0" >&2; exit 2 ;;
+    esac
+done
+
+cd "$(dirname "$0")" || exit 2
+tmp=$(mktemp -d) || exit 2
+trap 'rm -rf "$tmp"' EXIT
+
+${CC:-cc} -O2 maze.c -o "$tmp/maze" -lm -lpthread || exit 2
+${CC:-cc} -O2 -DLIBMAZE -c maze.c -o "$tmp/maze.o" || exit 2
+${CXX:-c++} -O2 maze.cpp "$tmp/maze.o" -o "$tmp/maze_view" -lm -lpthread || exit 2
+IMPLS="c c-t4 view"
+if [ -z "$MAZE_GO" ] && go build -o "$tmp/maze_go" maze.go 2>/dev/null; then
+    MAZE_GO=$tmp/maze_go
+fi
+if [ -n "$MAZE_GO" ]; then
+    IMPLS="$IMPLS go"
+else
+    echo "skipping maze.go (it didn't build here, set MAZE_GO to one already built)" >&2
+fi
+
+# field <json> <name>: a number or string from a line of --stats=json
+field()
+{
+    printf '%s\n' "$1" | sed -n "s/.*\"$2\": \"*\([^,\" }]*\).*/\1/p"
+}
+
+# make_maze <impl> <height> <width> <depth> <seed>: one line of json for the maze
+make_maze()
+{
+    case $1 in
+        c)    "$tmp/maze" -h $2 -w $3 -d $4 -r $5 -o /dev/null -T json 2>&1 >/dev/null | head -1 ;;
+        c-t4) "$tmp/maze" -h $2 -w $3 -d $4 -r $5 -o /dev/null -T json -t 4 2>&1 >/dev/null | head -1 ;;
+        go)   "$MAZE_GO" -h $2 -w $3 -d $4 -r $5 -T json </dev/null 2>&1 >/dev/null | head -1 ;;
+        view) "$tmp/maze_view" -h $2 -w $3 -d $4 -r $5 -v null |
+              sed -n 's/.*: \([0-9.]*\) s, \([0-9.]*\) ms each.*way through \([0-9]*\) cells, walls hash \([0-9a-f]*\).*/{ "max_path_length": \3, "walls_hash": "\4", "phase_ms": { "all": \2 } }/p' ;;
+    esac
+}
+
+fail=0
+problem()
+{
+    echo "FAIL: $*"
+    fail=1
+}
+
+[ $generate = 1 ] && : > "$golden"
+printf '%-9s %5s %4s  %-4s  %8s %9s %13s %15s  %-16s %10s\n' \
+       size depth seed impl maze_len num_paths num_wall_push max_path_length walls_hash ms
+for size in $SIZES; do
+    h=${size%x*}
+    w=${size#*x}
+    for d in $DEPTHS; do
+        for s in $SEEDS; do
+            engine_hash=
+            for impl in $IMPLS; do
+                best=
+                hash=
+                r=0
+                while [ $r -lt $runs ]; do
+                    json=$(make_maze $impl $h $w $d $s)
+                    ms=$(printf '%s\n' "$json" | sed 's/.*"phase_ms": {//; s/}.*//' | tr ',' '\n' | awk -F: '{ t += $2 } END { printf "%.3f", t }')
+                    this=$(field "$json" walls_hash)
+                    if [ -z "$this" ]; then
+                        problem "$impl ${h}x$w depth $d seed $s: no stats"
+                        break
+                    fi
+                    [ -n "$hash" ] && [ "$this" != "$hash" ] && problem "$impl ${h}x$w depth $d seed $s: a different maze each run"
+                    hash=$this
+                    if [ -z "$best" ] || awk "BEGIN { exit !($ms < $best) }"; then
+                        best=$ms
+                        best_json=$json
+                    fi
+                    r=$((r + 1))
+                done
+                [ -z "$hash" ] && continue
+                json=$best_json
+                printf '%-9s %5d %4d  %-4s  %8s %9s %13s %15s  %-16s %10s\n' ${h}x$w $d $s $impl \
+                       "$(field "$json" maze_len)" "$(field "$json" num_paths)" "$(field "$json" num_wall_push)" \
+                       "$(field "$json" max_path_length)" $hash $best
+                echo "$impl $best$(for p in initialize carve push analyze openings solve; do v=$(field "$json" $p); printf ' %s' "${v:-0}"; done)" >> "$tmp/times"
+
+                len=$(field "$json" maze_len)
+                [ -n "$len" ] && [ "$len" -ne $((h*w - 1)) ] && problem "$impl ${h}x$w depth $d seed $s: maze_len $len, not a perfect maze"
+                case $impl in go) key=go ;; *) key=engine ;; esac
+                if [ $key = engine ]; then
+                    [ -z "$engine_hash" ] && engine_hash=$hash
+                    [ "$hash" != "$engine_hash" ] && problem "$impl ${h}x$w depth $d seed $s: not the maze maze.c made"
+                fi
+                if [ $generate = 1 ]; then
+                    [ $impl = c ] || [ $impl = go ] && echo "$key $h $w $d $s $hash" >> "$golden"
+                else
+                    want=$(awk -v k=$key -v h=$h -v w=$w -v d=$d -v s=$s '$1 == k && $2 == h && $3 == w && $4 == d && $5 == s { print $6 }' "$golden" 2>/dev/null)
+                    if [ -z "$want" ]; then
+                        problem "$impl ${h}x$w depth $d seed $s: no golden hash in $golden (make some with -g)"
+                    elif [ "$hash" != "$want" ]; then
+                        problem "$impl ${h}x$w depth $d seed $s: walls hash $hash, not $want"
+                    fi
+                fi
+            done
+        done
+    done
+done
+
+# The fastest time for each maze, added up for each implementation and phase (maze.go has no analyze phase,
+# and maze_view only times the whole maze)
+echo
+printf '%-5s %6s %11s %10s %10s %10s %10s %10s %10s\n' impl mazes initialize carve push analyze openings solve "total ms"
+awk '{ n[$1]++; for (i = 2; i <= NF; i++) t[$1, i] += $i }
+     END { for (m in n) printf "%-5s %6d %11.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", m, n[m], t[m, 3], t[m, 4], t[m, 5], t[m, 6], t[m, 7], t[m, 8], t[m, 2] }' \
+    "$tmp/times" | sort
+awk '{ t[$1] += $2 } END { for (m in t) printf "%s %.3f\n", m, t[m] }' "$tmp/times" | sort > "$tmp/totals"
+
+[ -n "$save" ] && cp "$tmp/totals" "$save"
+if [ -n "$baseline" ]; then
+    while read impl then; do
+        now=$(awk -v m=$impl '$1 == m { print $2 }' "$tmp/totals")
+        [ -z "$now" ] && continue
+        pct=$(awk "BEGIN { printf \"%+.1f\", 100*($now - $then)/$then }")
+        echo "$impl: ${then} -> ${now} ms ($pct%)"
+        awk "BEGIN { exit !($now > $then*(1 + $threshold/100)) }" && problem "$impl is more than $threshold% slower than in $baseline"
+    done < "$baseline"
+fi
+
+[ $generate = 1 ] && echo "golden hashes written to $golden"
+[ $fail = 0 ] && echo ok
+exit $fail